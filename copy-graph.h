@@ -0,0 +1,106 @@
+#ifndef __COPY_GRAPH_H__
+# define __COPY_GRAPH_H__
+
+/**
+ *  Graphs of copies with dependencies, run on the device timeline: each
+ *  dependency becomes a wait event of the dependent copy, so that the host
+ *  only waits for the sinks of the graph (the copies no other depends on).
+ *
+ *      copy_graph_t g;
+ *      unsigned int a = copy_graph_add(&g, h2d_region, engine, {});
+ *      unsigned int b = copy_graph_add(&g, d2h_region, other_engine, { a });
+ *      copy_graph_submit(&g, engines, &events);
+ *      copy_graph_wait(&g);
+ *      copy_graph_release(&g, &events);
+ *
+ *  Nodes depend on nodes added before them, so that the insertion order is
+ *  a topological order, and each node is appended once its dependencies
+ *  have their event. Every node signals its own event (from an event
+ *  allocator, see ze-event-pool.h) and waits for the events of its
+ *  dependencies, across engines if needed. A graph can be submitted again
+ *  once released.
+ */
+
+# include <initializer_list>
+# include <vector>
+
+# include <ze_api.h>
+
+# include "logger-ze.h"
+# include "strided-copy.h"
+# include "ze-device.h"
+# include "ze-event-pool.h"
+
+typedef struct  copy_node_s
+{
+    strided_region_t region;
+    unsigned int engine;
+    std::vector<unsigned int> deps;
+    bool sink;                  // no node depends on it
+    event_t * event;            // once submitted
+}               copy_node_t;
+
+typedef struct  copy_graph_s
+{
+    std::vector<copy_node_t> nodes;
+}               copy_graph_t;
+
+// add a copy of 'region' on 'engine' after the nodes 'deps', returns its node
+static inline unsigned int
+copy_graph_add(copy_graph_t * g, const strided_region_t & region, unsigned int engine, std::initializer_list<unsigned int> deps)
+{
+    const unsigned int id = (unsigned int) g->nodes.size();
+    copy_node_t node;
+    node.region = region;
+    node.engine = engine;
+    node.deps   = deps;
+    node.sink   = true;
+    node.event  = NULL;
+    for (unsigned int d : node.deps)
+    {
+        if (d >= id)
+            LOGGER_FATAL("Node `%u` depends on `%u`, which is not added yet", id, d);
+        g->nodes[d].sink = false;
+    }
+    g->nodes.push_back(node);
+    return id;
+}
+
+// append every node to the list of its engine, waiting for its dependencies
+static inline void
+copy_graph_submit(copy_graph_t * g, const ze_engine_t * engines, event_allocator_t * events)
+{
+    std::vector<ze_event_handle_t> wait;
+    for (copy_node_t & node : g->nodes)
+    {
+        wait.clear();
+        for (unsigned int d : node.deps)
+            wait.push_back(g->nodes[d].event->event);
+        node.event = event_alloc(events);
+        strided_copy_ze_region(engines[node.engine].list, &node.region, node.event->event,
+                (uint32_t) wait.size(), wait.empty() ? NULL : wait.data());
+    }
+}
+
+// wait for the sinks, hence for every node
+static inline void
+copy_graph_wait(const copy_graph_t * g)
+{
+    for (const copy_node_t & node : g->nodes)
+        if (node.sink)
+            ZE_SAFE_CALL(zeEventHostSynchronize(node.event->event, UINT64_MAX));
+}
+
+// recycle the events of a completed graph
+static inline void
+copy_graph_release(copy_graph_t * g, event_allocator_t * events)
+{
+    for (copy_node_t & node : g->nodes)
+    {
+        if (node.event)
+            event_free(events, node.event);
+        node.event = NULL;
+    }
+}
+
+#endif /* __COPY_GRAPH_H__ */
@@ -0,0 +1,258 @@
+/**
+ *  Render a binary logger file (see LOGGER_BINARY in logger.h) back to the
+ *  text format of the synchronous logger:
+ *      [time][TID=tid] [HEADER] [LEVEL] message
+ *
+ *  usage: logger-decode [FILE]
+ */
+
+# include <assert.h>
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+
+# include <vector>
+# include <string>
+
+# include "logger.h"
+
+typedef struct  format_s
+{
+    bool        defined;
+    uint32_t    line;
+    std::string header;
+    std::string file;
+    std::string fmt;
+    std::string signature;
+}               format_t;
+
+// read exactly 'size' bytes, returns 'false' on end of file
+static bool
+read_exact(FILE * f, void * buffer, size_t size)
+{
+    return size == 0 || fread(buffer, size, 1, f) == 1;
+}
+
+// render the argument 'arg' of type 'code' with the printf conversion 'spec'
+static void
+render_arg(std::string & out, const char * spec, char conversion, char code, const char * arg, uint16_t slen)
+{
+    char buffer[512];
+    int n = 0;
+
+    // rebuild the spec with a 64-bits length modifier, as arguments were widened
+    std::string s(spec);
+    while (!s.empty() && strchr("hlLqjzt", s.back()))
+        s.pop_back();
+
+    if (code == 's')
+    {
+        std::string str(arg, slen);
+        if (conversion == 's')
+            n = snprintf(buffer, sizeof(buffer), (s + "s").c_str(), str.c_str());
+        else
+            n = snprintf(buffer, sizeof(buffer), "%s", str.c_str());
+    }
+    else
+    {
+        uint64_t raw;
+        memcpy(&raw, arg, sizeof(raw));
+        double d;
+        memcpy(&d, arg, sizeof(d));
+
+        switch (conversion)
+        {
+            case 'd':
+            case 'i':
+                n = snprintf(buffer, sizeof(buffer), (s + "ll" + conversion).c_str(),
+                        (long long) (code == 'd' ? (int64_t) d : (int64_t) raw));
+                break ;
+
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                n = snprintf(buffer, sizeof(buffer), (s + "ll" + conversion).c_str(),
+                        (unsigned long long) (code == 'd' ? (uint64_t) d : raw));
+                break ;
+
+            case 'c':
+                n = snprintf(buffer, sizeof(buffer), (s + conversion).c_str(), (int) raw);
+                break ;
+
+            case 'e': case 'E':
+            case 'f': case 'F':
+            case 'g': case 'G':
+            case 'a': case 'A':
+                n = snprintf(buffer, sizeof(buffer), (s + conversion).c_str(),
+                        code == 'd' ? d : (code == 'i' ? (double) (int64_t) raw : (double) raw));
+                break ;
+
+            case 'p':
+                n = snprintf(buffer, sizeof(buffer), (s + conversion).c_str(), (void *) (uintptr_t) raw);
+                break ;
+
+            default:
+                n = snprintf(buffer, sizeof(buffer), "<%%%c?>", conversion);
+                break ;
+        }
+    }
+
+    if (n > 0)
+        out.append(buffer, (size_t) n < sizeof(buffer) ? (size_t) n : sizeof(buffer) - 1);
+}
+
+// render the event payload with the given format
+static std::string
+render(const format_t & format, const char * payload, uint32_t len)
+{
+    std::string out;
+    const char * fmt = format.fmt.c_str();
+    const char * signature = format.signature.c_str();
+    uint32_t off = 0;
+
+    while (*fmt)
+    {
+        if (*fmt != '%')
+        {
+            out.push_back(*fmt++);
+            continue ;
+        }
+        if (fmt[1] == '%')
+        {
+            out.push_back('%');
+            fmt += 2;
+            continue ;
+        }
+
+        // parse '%[flags][width][.precision][length]conversion'
+        const char * start = fmt++;
+        while (*fmt && !strchr("diouxXeEfFgGaAcspn", *fmt))
+            ++fmt;
+        if (*fmt == '\0')
+            break ;
+        const char conversion = *fmt++;
+        std::string spec(start, fmt - 1);
+
+        // '*' width/precision are not supported: drop them
+        if (spec.find('*') != std::string::npos)
+            spec = "%";
+
+        // next argument
+        const char code = *signature;
+        if (code == '\0')
+        {
+            out.append("<?>");
+            continue ;
+        }
+        ++signature;
+
+        if (code == 's')
+        {
+            uint16_t slen;
+            if (off + sizeof(slen) > len)
+            {
+                out.append("<?>");
+                continue ;
+            }
+            memcpy(&slen, payload + off, sizeof(slen));
+            off += sizeof(slen);
+            if (off + slen > len)
+                slen = (uint16_t) (len - off);
+            render_arg(out, spec.c_str(), conversion, code, payload + off, slen);
+            off += slen;
+        }
+        else
+        {
+            if (off + 8 > len)
+            {
+                out.append("<?>");
+                continue ;
+            }
+            render_arg(out, spec.c_str(), conversion, code, payload + off, 0);
+            off += 8;
+        }
+    }
+
+    return out;
+}
+
+int
+main(int argc, char ** argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s [FILE]\n", argv[0]);
+        return 1;
+    }
+
+    FILE * f = fopen(argv[1], "rb");
+    if (f == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    char magic[sizeof(LOGGER_BINARY_MAGIC)];
+    if (!read_exact(f, magic, sizeof(magic)) || memcmp(magic, LOGGER_BINARY_MAGIC, sizeof(magic)))
+    {
+        fprintf(stderr, "`%s` is not a binary logger file\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<format_t> formats;
+    std::vector<char> payload;
+    uint64_t origin = 0;
+
+    logger_binary_entry_t entry;
+    while (read_exact(f, &entry, sizeof(entry)))
+    {
+        payload.resize(entry.len + 1);
+        if (!read_exact(f, payload.data(), entry.len))
+        {
+            fprintf(stderr, "Truncated file\n");
+            return 1;
+        }
+        payload[entry.len] = '\0';
+
+        if (entry.id == LOGGER_BINARY_DEFINE_ID)
+        {
+            const char * p = payload.data();
+            uint32_t line;
+            uint16_t id;
+            memcpy(&line, p, sizeof(line)); p += sizeof(line);
+            memcpy(&id,   p, sizeof(id));   p += sizeof(id);
+            if (formats.size() <= id)
+                formats.resize(id + 1);
+            format_t & format = formats[id];
+            format.defined   = true;
+            format.line      = line;
+            format.header    = p; p += format.header.size()    + 1;
+            format.file      = p; p += format.file.size()      + 1;
+            format.fmt       = p; p += format.fmt.size()       + 1;
+            format.signature = p;
+            continue ;
+        }
+
+        if (entry.id >= formats.size() || !formats[entry.id].defined)
+        {
+            fprintf(stderr, "Event with undefined format `%u`\n", entry.id);
+            continue ;
+        }
+        const format_t & format = formats[entry.id];
+
+        // same semantic as the text logger: time elapsed since the first record
+        if (origin == 0)
+            origin = entry.t;
+        const double elapsed = (double) (int64_t) (entry.t - origin) / 1e9;
+
+        std::string msg = render(format, payload.data(), entry.len);
+        printf("[%8lf][TID=%d] [%s] [%s] %s\n",
+                elapsed, entry.tid, format.header.c_str(),
+                entry.lvl < 6 ? LOGGER_PRINT_HEADERS[entry.lvl] : "?", msg.c_str());
+    }
+
+    fclose(f);
+
+    return 0;
+}
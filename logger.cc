@@ -11,14 +11,19 @@
 /*                                                                            */
 /* ************************************************************************** */
 
+# include <pthread.h>
 # include <stdint.h>
+# include <string.h>
+# include <strings.h>
+# include <time.h>
+# include <unistd.h>
 
+# include "logger.h"
 # include "spinlock.h"
 
 volatile spinlock_t LOGGER_PRINT_MTX;
 
-volatile double     LOGGER_TIME_ELAPSED = 0.0;
-volatile uint64_t   LOGGER_LAST_TIME    = 0;
+volatile uint64_t   LOGGER_TIME_ORIGIN  = 0;
 
 # define NLVL 6
 
@@ -41,3 +46,481 @@ char const * LOGGER_PRINT_HEADERS[NLVL] = {
 };
 
 int LOGGER_VERBOSE = NLVL;
+
+/* parse a level id or name, returns -1 if invalid */
+static int
+logger_verbose_parse(char const * s, size_t n)
+{
+    if (n == 0)
+        return -1;
+
+    char * end;
+    long lvl = strtol(s, &end, 10);
+    if (end == s + n)
+        return (int) lvl;
+
+    for (int i = 0 ; i < NLVL ; ++i)
+        if (strlen(LOGGER_PRINT_HEADERS[i]) == n && strncasecmp(s, LOGGER_PRINT_HEADERS[i], n) == 0)
+            return i;
+
+    return -1;
+}
+
+int
+logger_verbose(char const * header)
+{
+    char const * env = getenv("LOGGER_VERBOSE");
+    if (env == NULL)
+        return LOGGER_VERBOSE;
+
+    int global = LOGGER_VERBOSE;
+    int module = -1;
+
+    /* 'LVL' or 'HEADER=LVL' tokens, separated by ',' */
+    char const * token = env;
+    while (*token)
+    {
+        char const * end = strchr(token, ',');
+        if (end == NULL)
+            end = token + strlen(token);
+
+        char const * eq = (char const *) memchr(token, '=', end - token);
+        if (eq == NULL)
+        {
+            int lvl = logger_verbose_parse(token, end - token);
+            if (lvl >= 0)
+                global = lvl;
+        }
+        else if ((size_t) (eq - token) == strlen(header) && strncmp(token, header, eq - token) == 0)
+        {
+            int lvl = logger_verbose_parse(eq + 1, end - eq - 1);
+            if (lvl >= 0)
+                module = lvl;
+        }
+
+        token = *end ? end + 1 : end;
+    }
+
+    return module >= 0 ? module : global;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  TIME                                                                      //
+////////////////////////////////////////////////////////////////////////////////
+
+# if defined(__x86_64__) || defined(__i386__)
+#  include <cpuid.h>
+# endif
+
+/* duration of the TSC calibration, in ns */
+# define LOGGER_TIME_CALIBRATION_NS 10000000
+
+int         LOGGER_TIME_TSC         = 0;
+double      LOGGER_TIME_NS_PER_TICK = 1.0;
+uint64_t    LOGGER_TIME_BASE_TICKS  = 0;
+uint64_t    LOGGER_TIME_BASE_NS     = 0;
+
+/* CPUID.80000007H:EDX[8] */
+static int
+logger_time_tsc_invariant(void)
+{
+# if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007)
+        return 0;
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0)
+        return 0;
+    return (edx >> 8) & 1;
+# else
+    return 0;
+# endif
+}
+
+/* runs before any C++ static initializer, so before any record */
+__attribute__((constructor(101)))
+static void
+logger_time_init(void)
+{
+    char const * env = getenv("LOGGER_CLOCK");
+    if ((env && strcmp(env, "monotonic") == 0) || !logger_time_tsc_invariant())
+        return ;
+
+# if defined(__x86_64__) || defined(__i386__)
+    const uint64_t ns0  = logger_time_monotonic();
+    const uint64_t tsc0 = __rdtsc();
+    uint64_t ns1, tsc1;
+    do {
+        ns1  = logger_time_monotonic();
+        tsc1 = __rdtsc();
+    } while (ns1 - ns0 < LOGGER_TIME_CALIBRATION_NS);
+
+    LOGGER_TIME_NS_PER_TICK = (double) (ns1 - ns0) / (double) (tsc1 - tsc0);
+    LOGGER_TIME_BASE_TICKS  = tsc1;
+    LOGGER_TIME_BASE_NS     = ns1;
+    LOGGER_TIME_TSC         = 1;
+# endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  ASYNC BACKEND                                                             //
+////////////////////////////////////////////////////////////////////////////////
+
+/* flusher period when there is nothing to write, in us */
+# define LOGGER_ASYNC_PERIOD_US 1000
+
+/* size of the flusher write buffer */
+# define LOGGER_ASYNC_BUFFER_SIZE (64 * 1024)
+
+/**
+ *  Single-producer single-consumer ring: the owning thread is the only one
+ *  to move 'head', the flusher (holding LOGGER_ASYNC_DRAIN_MTX) is the only
+ *  one to move 'tail'. Rings are never freed: when a thread exits, its ring
+ *  is released and may be adopted by a thread created later.
+ */
+typedef struct  logger_ring_s
+{
+    /* written by the producer */
+    alignas(64) volatile uint64_t head;
+
+    /* written by the consumer */
+    alignas(64) volatile uint64_t tail;
+
+    /* '1' if a thread currently owns that ring */
+    alignas(64) volatile int owned;
+    int tid;
+    struct logger_ring_s * next;
+
+    logger_record_t records[LOGGER_ASYNC_RING_SIZE];
+
+}               logger_ring_t;
+
+/* every rings ever created (push only) */
+static logger_ring_t * volatile LOGGER_ASYNC_RINGS = NULL;
+
+/* calling thread ring */
+static thread_local logger_ring_t * LOGGER_ASYNC_RING = NULL;
+
+/* only one consumer at a time */
+static spinlock_t LOGGER_ASYNC_DRAIN_MTX = SPINLOCK_INITIALIZER;
+
+static pthread_once_t   LOGGER_ASYNC_ONCE = PTHREAD_ONCE_INIT;
+static pthread_key_t    LOGGER_ASYNC_KEY;
+static pthread_t        LOGGER_ASYNC_FLUSHER;
+static volatile int     LOGGER_ASYNC_STOP = 0;
+static int              LOGGER_ASYNC_TTY;
+
+/* flusher write buffers, only accessed holding LOGGER_ASYNC_DRAIN_MTX */
+typedef struct  logger_buffer_s
+{
+    int     fd;
+    size_t  len;
+    char    data[LOGGER_ASYNC_BUFFER_SIZE];
+}               logger_buffer_t;
+
+/* text records */
+static logger_buffer_t LOGGER_ASYNC_BUFFER;
+
+/* binary records */
+static logger_buffer_t LOGGER_BINARY_BUFFER;
+
+static void
+logger_buffer_write(int fd, const char * data, size_t len)
+{
+    size_t off = 0;
+    while (off < len)
+    {
+        ssize_t n = write(fd, data + off, len - off);
+        if (n <= 0)
+            break ;
+        off += (size_t) n;
+    }
+}
+
+static void
+logger_async_write(logger_buffer_t * buffer)
+{
+    logger_buffer_write(buffer->fd, buffer->data, buffer->len);
+    buffer->len = 0;
+}
+
+static void
+logger_async_format(logger_record_t * r)
+{
+    logger_buffer_t * buffer = &LOGGER_ASYNC_BUFFER;
+
+    /* a record is at most 'LOGGER_ASYNC_RECORD_SIZE' plus its prefix */
+    if (buffer->len + 2 * LOGGER_ASYNC_RECORD_SIZE > LOGGER_ASYNC_BUFFER_SIZE)
+        logger_async_write(buffer);
+
+    const double elapsed = logger_time_elapsed(r->t);
+    char * data = buffer->data + buffer->len;
+    const size_t size = LOGGER_ASYNC_BUFFER_SIZE - buffer->len;
+    int n;
+    if (LOGGER_ASYNC_TTY)
+        n = snprintf(data, size, "[%8lf] [TID=%d] [\033[1;37m%s\033[0m] [%s%s\033[0m] ",
+                elapsed, r->tid, r->header, LOGGER_PRINT_COLORS[r->lvl], LOGGER_PRINT_HEADERS[r->lvl]);
+    else
+        n = snprintf(data, size, "[%8lf][TID=%d] [%s] [%s] ",
+                elapsed, r->tid, r->header, LOGGER_PRINT_HEADERS[r->lvl]);
+    if (n < 0)
+        return ;
+    memcpy(data + n, r->msg, r->len);
+    n += r->len;
+    data[n++] = '\n';
+    buffer->len += (size_t) n;
+}
+
+static void
+logger_binary_format(logger_record_t * r)
+{
+    logger_buffer_t * buffer = &LOGGER_BINARY_BUFFER;
+
+    if (buffer->len + sizeof(logger_binary_entry_t) + r->len > LOGGER_ASYNC_BUFFER_SIZE)
+        logger_async_write(buffer);
+
+    logger_binary_entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.t     = logger_time_ns(r->t);
+    entry.tid   = r->tid;
+    entry.id    = r->id;
+    entry.lvl   = (uint8_t) r->lvl;
+    entry.len   = r->len;
+    memcpy(buffer->data + buffer->len, &entry, sizeof(entry));
+    memcpy(buffer->data + buffer->len + sizeof(entry), r->msg, r->len);
+    buffer->len += sizeof(entry) + r->len;
+}
+
+/* must be called holding LOGGER_ASYNC_DRAIN_MTX - returns the number of records written */
+static size_t
+logger_async_drain_locked(void)
+{
+    /* snapshot every rings, then merge their records by timestamp */
+    size_t n = 0;
+    while (1)
+    {
+        logger_ring_t * next = NULL;
+        for (logger_ring_t * ring = LOGGER_ASYNC_RINGS ; ring ; ring = ring->next)
+        {
+            if (ring->tail == ring->head)
+                continue ;
+            if (next == NULL ||
+                    ring->records[ring->tail % LOGGER_ASYNC_RING_SIZE].t <
+                    next->records[next->tail % LOGGER_ASYNC_RING_SIZE].t)
+                next = ring;
+        }
+        if (next == NULL)
+            break ;
+
+        readmem_barrier();
+        logger_record_t * r = next->records + (next->tail % LOGGER_ASYNC_RING_SIZE);
+        if (r->id == LOGGER_TEXT_ID)
+            logger_async_format(r);
+        else
+            logger_binary_format(r);
+        mem_barrier();
+        next->tail = next->tail + 1;
+        ++n;
+    }
+    logger_async_write(&LOGGER_ASYNC_BUFFER);
+    logger_async_write(&LOGGER_BINARY_BUFFER);
+    return n;
+}
+
+void
+logger_async_drain(void)
+{
+    SPINLOCK_LOCK(LOGGER_ASYNC_DRAIN_MTX);
+    logger_async_drain_locked();
+    SPINLOCK_UNLOCK(LOGGER_ASYNC_DRAIN_MTX);
+}
+
+static void *
+logger_async_flusher(void * args)
+{
+    (void) args;
+    while (!LOGGER_ASYNC_STOP)
+    {
+        SPINLOCK_LOCK(LOGGER_ASYNC_DRAIN_MTX);
+        size_t n = logger_async_drain_locked();
+        SPINLOCK_UNLOCK(LOGGER_ASYNC_DRAIN_MTX);
+        if (n == 0)
+            usleep(LOGGER_ASYNC_PERIOD_US);
+    }
+    return NULL;
+}
+
+static void
+logger_async_fini(void)
+{
+    LOGGER_ASYNC_STOP = 1;
+    pthread_join(LOGGER_ASYNC_FLUSHER, NULL);
+    logger_async_drain();
+}
+
+/* called on thread exit, so that the ring can be adopted by another thread */
+static void
+logger_async_release(void * args)
+{
+    logger_ring_t * ring = (logger_ring_t *) args;
+    mem_barrier();
+    ring->owned = 0;
+}
+
+static void
+logger_async_init(void)
+{
+    LOGGER_ASYNC_BUFFER.fd = fileno(LOGGER_FD);
+    LOGGER_ASYNC_TTY = isatty(STDOUT_FILENO);
+    pthread_key_create(&LOGGER_ASYNC_KEY, logger_async_release);
+    pthread_create(&LOGGER_ASYNC_FLUSHER, NULL, logger_async_flusher, NULL);
+    atexit(logger_async_fini);
+}
+
+static logger_ring_t *
+logger_async_ring(void)
+{
+    pthread_once(&LOGGER_ASYNC_ONCE, logger_async_init);
+
+    logger_ring_t * ring;
+
+    /* try to adopt a released ring */
+    for (ring = LOGGER_ASYNC_RINGS ; ring ; ring = ring->next)
+        if (ring->owned == 0 && __sync_bool_compare_and_swap(&ring->owned, 0, 1))
+            break ;
+
+    /* else create a new one */
+    if (ring == NULL)
+    {
+        ring = (logger_ring_t *) aligned_alloc(alignof(logger_ring_t), sizeof(logger_ring_t));
+        if (ring == NULL)
+            abort();
+        ring->head  = 0;
+        ring->tail  = 0;
+        ring->owned = 1;
+        ring->tid   = gettid();
+        do {
+            ring->next = LOGGER_ASYNC_RINGS;
+        } while (!__sync_bool_compare_and_swap(&LOGGER_ASYNC_RINGS, ring->next, ring));
+    }
+    else
+        ring->tid = gettid();
+
+    pthread_setspecific(LOGGER_ASYNC_KEY, ring);
+    return ring;
+}
+
+logger_record_t *
+logger_async_reserve(void)
+{
+    logger_ring_t * ring = LOGGER_ASYNC_RING;
+    if (ring == NULL)
+        ring = LOGGER_ASYNC_RING = logger_async_ring();
+
+    /* wait for the flusher to make room, or make it once it stopped */
+    while (ring->head - ring->tail >= LOGGER_ASYNC_RING_SIZE)
+    {
+        if (LOGGER_ASYNC_STOP)
+            logger_async_drain();
+        else
+            mem_pause();
+    }
+    readmem_barrier();
+
+    logger_record_t * r = ring->records + (ring->head % LOGGER_ASYNC_RING_SIZE);
+    r->tid = ring->tid;
+    r->id  = LOGGER_TEXT_ID;
+    return r;
+}
+
+void
+logger_async_commit(void)
+{
+    logger_ring_t * ring = LOGGER_ASYNC_RING;
+    writemem_barrier();
+    ring->head = ring->head + 1;
+
+    /* no flusher anymore (exiting): write it right away */
+    if (LOGGER_ASYNC_STOP)
+        logger_async_drain();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  BINARY BACKEND                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+# include <fcntl.h>
+
+/* last format id given */
+static volatile uint16_t LOGGER_BINARY_LAST_ID = LOGGER_TEXT_ID;
+
+static pthread_once_t LOGGER_BINARY_ONCE = PTHREAD_ONCE_INIT;
+
+static void
+logger_binary_init(void)
+{
+    const char * path = getenv("LOGGER_BINARY_FILE");
+    if (path == NULL)
+        path = LOGGER_BINARY_FILE;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        perror(path);
+        abort();
+    }
+    logger_buffer_write(fd, LOGGER_BINARY_MAGIC, sizeof(LOGGER_BINARY_MAGIC));
+    LOGGER_BINARY_BUFFER.fd = fd;
+}
+
+uint16_t
+logger_binary_register(
+    char const * header,
+    char const * file,
+    int line,
+    char const * fmt,
+    char const * signature
+) {
+    pthread_once(&LOGGER_BINARY_ONCE, logger_binary_init);
+
+    const uint16_t id = __sync_add_and_fetch(&LOGGER_BINARY_LAST_ID, 1);
+    if (id == LOGGER_BINARY_DEFINE_ID)
+    {
+        fprintf(stderr, "Too many binary logger call sites\n");
+        abort();
+    }
+
+    /* [entry] [line] [header\0] [file\0] [fmt\0] [signature\0] */
+    const size_t lheader    = strlen(header)    + 1;
+    const size_t lfile      = strlen(file)      + 1;
+    const size_t lfmt       = strlen(fmt)       + 1;
+    const size_t lsignature = strlen(signature) + 1;
+
+    logger_binary_entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.id  = LOGGER_BINARY_DEFINE_ID;
+    entry.len = (uint32_t) (sizeof(uint32_t) + sizeof(uint16_t) + lheader + lfile + lfmt + lsignature);
+
+    char * data = (char *) malloc(sizeof(entry) + entry.len);
+    if (data == NULL)
+        abort();
+
+    const uint32_t uline = (uint32_t) line;
+    char * p = data;
+    memcpy(p, &entry,       sizeof(entry));     p += sizeof(entry);
+    memcpy(p, &uline,       sizeof(uline));     p += sizeof(uline);
+    memcpy(p, &id,          sizeof(id));        p += sizeof(id);
+    memcpy(p, header,       lheader);           p += lheader;
+    memcpy(p, file,         lfile);             p += lfile;
+    memcpy(p, fmt,          lfmt);              p += lfmt;
+    memcpy(p, signature,    lsignature);        p += lsignature;
+
+    /* written directly, holding the drain lock, so that the definition
+     * always precedes the events using it in the file */
+    SPINLOCK_LOCK(LOGGER_ASYNC_DRAIN_MTX);
+    logger_buffer_write(LOGGER_BINARY_BUFFER.fd, data, (size_t) (p - data));
+    SPINLOCK_UNLOCK(LOGGER_ASYNC_DRAIN_MTX);
+
+    free(data);
+
+    return id;
+}
@@ -21,6 +21,13 @@
 # include <stdio.h>
 # include <stdlib.h>
 # include <stdint.h>
+# include <string.h>
+
+# include <type_traits>
+
+# if defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+# endif
 
 extern spinlock_t LOGGER_PRINT_MTX;
 
@@ -39,35 +46,345 @@ extern spinlock_t LOGGER_PRINT_MTX;
 # define LOGGER_PRINT_IMPL_ID       4
 # define LOGGER_PRINT_DEBUG_ID      5
 
-extern char * LOGGER_PRINT_COLORS[6];
-extern char * LOGGER_PRINT_HEADERS[6];
+extern char const * LOGGER_PRINT_COLORS[6];
+extern char const * LOGGER_PRINT_HEADERS[6];
+
+/**
+ *  Levels are filtered twice:
+ *  - at compile time, call sites of a level greater than
+ *    'LOGGER_COMPILE_VERBOSE' are removed, with their arguments evaluation
+ *  - at runtime, against the verbosity of the module 'LOGGER_HEADER', set
+ *    once at startup from the environment variable `LOGGER_VERBOSE`, which
+ *    is a comma-separated list of a default level and of per-module levels,
+ *    levels being an id or a name. For instance:
+ *      LOGGER_VERBOSE=WARN,MEMCPY2D=INFO,ZES-LEAK=5
+ */
+# ifndef LOGGER_COMPILE_VERBOSE
+#  ifndef NDEBUG
+#   define LOGGER_COMPILE_VERBOSE LOGGER_PRINT_DEBUG_ID
+#  else
+#   define LOGGER_COMPILE_VERBOSE LOGGER_PRINT_IMPL_ID
+#  endif
+# endif
 
+/* default runtime verbosity, if not set by the environment */
 extern int LOGGER_VERBOSE;
 
-extern volatile double   LOGGER_TIME_ELAPSED;
-extern volatile uint64_t LOGGER_LAST_TIME;
+/* runtime verbosity of the module 'header', parsed from the environment */
+int logger_verbose(char const * header);
+
+/* runtime verbosity of the current module */
+static int LOGGER_MODULE_VERBOSE __attribute__((unused)) = logger_verbose(LOGGER_HEADER);
+
+# define LOGGER_ENABLED(LVL) \
+    ((LVL) <= LOGGER_COMPILE_VERBOSE && (LVL) <= LOGGER_MODULE_VERBOSE)
+
+/* compiled out call site: never evaluated, but still type-checked */
+# define LOGGER_DISCARD(...)                                \
+    do {                                                    \
+        if (0)                                              \
+            fprintf(LOGGER_FD, __VA_ARGS__);                \
+    } while (0)
+
+/**
+ *  Timestamps are raw ticks of the invariant TSC, calibrated once at startup
+ *  against CLOCK_MONOTONIC. If the TSC is not invariant (or if the
+ *  environment variable `LOGGER_CLOCK=monotonic`), ticks are nanoseconds
+ *  read with `clock_gettime(CLOCK_MONOTONIC)`.
+ *  The elapsed time of a record is computed from the ticks of the first
+ *  record 'LOGGER_TIME_ORIGIN'.
+ */
+extern int      LOGGER_TIME_TSC;
+extern double   LOGGER_TIME_NS_PER_TICK;
+extern uint64_t LOGGER_TIME_BASE_TICKS;
+extern uint64_t LOGGER_TIME_BASE_NS;
+
+extern volatile uint64_t LOGGER_TIME_ORIGIN;
+
+static inline uint64_t
+logger_time_monotonic(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+/* current time, in ticks */
+static inline uint64_t
+logger_time_now(void)
+{
+# if defined(__x86_64__) || defined(__i386__)
+    if (LOGGER_TIME_TSC)
+        return __rdtsc();
+# endif
+    return logger_time_monotonic();
+}
+
+/* convert ticks to CLOCK_MONOTONIC nanoseconds */
+static inline uint64_t
+logger_time_ns(uint64_t t)
+{
+    return LOGGER_TIME_BASE_NS + (uint64_t) ((double) (int64_t) (t - LOGGER_TIME_BASE_TICKS) * LOGGER_TIME_NS_PER_TICK);
+}
+
+/* seconds elapsed between the first record and 't' (signed, as a thread may
+ * have won the race on the origin with a later time) */
+static inline double
+logger_time_elapsed(uint64_t t)
+{
+    return (double) (int64_t) (t - LOGGER_TIME_ORIGIN) * LOGGER_TIME_NS_PER_TICK / 1e9;
+}
 
 # define LOGGER_PRINT_LINE() \
     fprintf(LOGGER_FD, "%s:%d (%s)\n", __FILE__, __LINE__, __func__);
 
-# define LOGGER_PRINT(LVL, ...)                                                 \
+/**
+ *  Asynchronous backend: if 'LOGGER_ASYNC' is '1', callers only format their
+ *  message into a per-thread lock-free ring buffer, and a background flusher
+ *  thread (see logger.cc) prefixes and writes records in large `write()`s.
+ *  Records from different threads are merged by timestamp before writing.
+ */
+# ifndef LOGGER_ASYNC
+#  define LOGGER_ASYNC 0
+# endif
+
+/**
+ *  Size of a record, and number of records per thread ring. A message longer
+ *  than what fits in a record (a bit less than 'LOGGER_ASYNC_RECORD_SIZE')
+ *  is truncated, and ends with '...'.
+ */
+# define LOGGER_ASYNC_RECORD_SIZE   256
+# define LOGGER_ASYNC_RING_SIZE     1024
+
+typedef struct  logger_record_s
+{
+    uint64_t        t;
+    char const *    header;
+    int32_t         tid;
+    uint16_t        id;
+    uint16_t        lvl;
+    uint16_t        len;
+    char            msg[LOGGER_ASYNC_RECORD_SIZE - sizeof(uint64_t) - sizeof(char const *) - sizeof(int32_t) - 3 * sizeof(uint16_t)];
+}               logger_record_t;
+
+static_assert(sizeof(logger_record_t) == LOGGER_ASYNC_RECORD_SIZE, "Bad record size");
+
+/* reserve the next record of the calling thread ring (spins if the ring is full) */
+logger_record_t * logger_async_reserve(void);
+
+/* publish the record previously reserved */
+void logger_async_commit(void);
+
+/* write every pending records of every threads, returns once done */
+void logger_async_drain(void);
+
+/**
+ *  Binary backend: if 'LOGGER_BINARY' is '1', no formatting happens on the
+ *  producer side. Each call site registers its format string once and gets
+ *  an id, then records only carry the timestamp, TID, level, that id and the
+ *  raw arguments. Records go through the asynchronous rings and are written
+ *  to the file `$LOGGER_BINARY_FILE` (default: LOGGER_BINARY_FILE) that can
+ *  be rendered back to text with `logger-decode`.
+ *
+ *  File layout: LOGGER_BINARY_MAGIC, then a sequence of entries, each made of
+ *  a 'logger_binary_entry_t' followed by 'len' bytes of payload:
+ *      - if 'id == LOGGER_BINARY_DEFINE_ID', the payload defines a format:
+ *          [uint32_t line] [uint16_t id] [header\0] [file\0] [fmt\0] [signature\0]
+ *      - else, the payload holds the arguments of an event of format 'id',
+ *        as described by the signature: one char per argument, 'i' (int64_t),
+ *        'u' (uint64_t), 'd' (double), 'p' (pointer as uint64_t), or
+ *        's' (uint16_t length followed by the characters, no '\0').
+ *  A definition always precedes the events using it.
+ */
+# ifndef LOGGER_BINARY
+#  define LOGGER_BINARY 0
+# endif
+
+# ifndef LOGGER_BINARY_FILE
+#  define LOGGER_BINARY_FILE "logger.bin"
+# endif
+
+# define LOGGER_BINARY_MAGIC        "ZZLOGB01"
+# define LOGGER_TEXT_ID             0
+# define LOGGER_BINARY_DEFINE_ID    UINT16_MAX
+
+/* maximum length of a string argument */
+# define LOGGER_BINARY_STRLEN_MAX   64
+
+typedef struct  logger_binary_entry_s
+{
+    uint64_t    t;
+    int32_t     tid;
+    uint16_t    id;
+    uint8_t     lvl;
+    uint8_t     reserved;
+    uint32_t    len;
+    uint32_t    reserved2;
+}               logger_binary_entry_t;
+
+static_assert(sizeof(logger_binary_entry_t) == 24, "Bad entry size");
+
+/* register a call site format and returns its id */
+uint16_t logger_binary_register(char const * header, char const * file, int line, char const * fmt, char const * signature);
+
+template <typename T>
+static constexpr inline char
+logger_binary_code(void)
+{
+    if constexpr (std::is_convertible<T, char const *>::value)
+        return 's';
+    else if constexpr (std::is_pointer<T>::value || std::is_null_pointer<T>::value)
+        return 'p';
+    else if constexpr (std::is_floating_point<T>::value)
+        return 'd';
+    else if constexpr (std::is_integral<T>::value && std::is_signed<T>::value)
+        return 'i';
+    else
+    {
+        static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "Unsupported binary logger argument type");
+        return 'u';
+    }
+}
+
+template <typename... Args>
+struct  logger_binary_signature_t
+{
+    static constexpr char str[] = { logger_binary_code<Args>()..., '\0' };
+};
+
+/* never called: only used to deduce the signature of a call site in 'decltype' */
+template <typename... Args>
+logger_binary_signature_t<typename std::decay<Args>::type...> logger_binary_signature(char const * fmt, Args && ... args);
+
+template <typename T>
+static inline size_t
+logger_binary_pack(char * buffer, size_t off, size_t size, T x)
+{
+    constexpr char code = logger_binary_code<T>();
+    if constexpr (code == 's')
+    {
+        char const * s = x ? (char const *) x : "(null)";
+        uint16_t n = (uint16_t) strnlen(s, LOGGER_BINARY_STRLEN_MAX);
+        if (off + sizeof(n) + n > size)
+            return size;
+        memcpy(buffer + off, &n, sizeof(n));
+        memcpy(buffer + off + sizeof(n), s, n);
+        return off + sizeof(n) + n;
+    }
+    else
+    {
+        if (off + 8 > size)
+            return size;
+        if constexpr (code == 'd')
+        {
+            double v = (double) x;
+            memcpy(buffer + off, &v, 8);
+        }
+        else if constexpr (code == 'p')
+        {
+            uint64_t v = (uint64_t) (uintptr_t) x;
+            memcpy(buffer + off, &v, 8);
+        }
+        else if constexpr (code == 'i')
+        {
+            int64_t v = (int64_t) x;
+            memcpy(buffer + off, &v, 8);
+        }
+        else
+        {
+            uint64_t v = (uint64_t) x;
+            memcpy(buffer + off, &v, 8);
+        }
+        return off + 8;
+    }
+}
+
+template <typename... Args>
+static inline void
+logger_binary_emit(uint64_t t, int lvl, uint16_t id, char const * fmt, Args... args)
+{
+    (void) fmt;
+    logger_record_t * r = logger_async_reserve();
+    r->t    = t;
+    r->id   = id;
+    r->lvl  = (uint16_t) lvl;
+    size_t off = 0;
+    ((off = logger_binary_pack(r->msg, off, sizeof(r->msg), args)), ...);
+    r->len  = (uint16_t) off;
+    logger_async_commit();
+}
+
+/* first argument of a '__VA_ARGS__', that is the format */
+# define LOGGER_BINARY_FMT(...)         LOGGER_BINARY_FMT_(__VA_ARGS__, 0)
+# define LOGGER_BINARY_FMT_(FMT, ...)   FMT
+
+# if LOGGER_BINARY
+#  define LOGGER_PRINT(LVL, ...)                                                \
+    do {                                                                        \
+        if (LOGGER_ENABLED(LVL))                                                \
+        {                                                                       \
+            static const uint16_t _id = logger_binary_register(                 \
+                LOGGER_HEADER, __FILE__, __LINE__,                              \
+                LOGGER_BINARY_FMT(__VA_ARGS__),                                 \
+                decltype(logger_binary_signature(__VA_ARGS__))::str);           \
+            uint64_t t = logger_time_now();                                     \
+            if (LOGGER_TIME_ORIGIN == 0)                                        \
+                __sync_bool_compare_and_swap(&LOGGER_TIME_ORIGIN, 0, t);        \
+            logger_binary_emit(t, LVL, _id, __VA_ARGS__);                       \
+        }                                                                       \
+        if (LVL == LOGGER_PRINT_FATAL_ID)                                       \
+        {                                                                       \
+            logger_async_drain();                                               \
+            LOGGER_PRINT_LINE();                                                \
+            fflush(LOGGER_FD);                                                  \
+            abort();                                                            \
+        }                                                                       \
+    } while (0)
+
+# elif LOGGER_ASYNC
+#  define LOGGER_PRINT(LVL, ...)                                                \
+    do {                                                                        \
+        if (LOGGER_ENABLED(LVL))                                                \
+        {                                                                       \
+            uint64_t t = logger_time_now();                                     \
+            if (LOGGER_TIME_ORIGIN == 0)                                        \
+                __sync_bool_compare_and_swap(&LOGGER_TIME_ORIGIN, 0, t);        \
+            logger_record_t * _r = logger_async_reserve();                      \
+            _r->t      = t;                                                     \
+            _r->header = LOGGER_HEADER;                                         \
+            _r->lvl    = LVL;                                                   \
+            int _n = snprintf(_r->msg, sizeof(_r->msg), __VA_ARGS__);           \
+            _r->len = (_n < 0) ? 0 :                                            \
+                (_n >= (int) sizeof(_r->msg)) ? sizeof(_r->msg) - 1 : _n;       \
+            if (_n >= (int) sizeof(_r->msg))                                    \
+                memcpy(_r->msg + sizeof(_r->msg) - 4, "...", 3);                \
+            logger_async_commit();                                              \
+        }                                                                       \
+        if (LVL == LOGGER_PRINT_FATAL_ID)                                       \
+        {                                                                       \
+            logger_async_drain();                                               \
+            LOGGER_PRINT_LINE();                                                \
+            fflush(LOGGER_FD);                                                  \
+            abort();                                                            \
+        }                                                                       \
+    } while (0)
+
+# else /* LOGGER_BINARY, LOGGER_ASYNC */
+
+#  define LOGGER_PRINT(LVL, ...)                                                \
     do {                                                                        \
-        if (LVL <= LOGGER_VERBOSE)                                              \
+        if (LOGGER_ENABLED(LVL))                                                \
         {                                                                       \
             SPINLOCK_LOCK(LOGGER_PRINT_MTX);                                    \
-            struct timespec _ts;                                                \
-            clock_gettime(CLOCK_MONOTONIC, &_ts);                               \
-            uint64_t t = (uint64_t)(_ts.tv_sec * 1000000000) +                  \
-                            (uint64_t) _ts.tv_nsec;                             \
-            if (LOGGER_LAST_TIME != 0)                                          \
-                LOGGER_TIME_ELAPSED += (double) (t - LOGGER_LAST_TIME) / 1e9;   \
-            LOGGER_LAST_TIME = t;                                               \
+            uint64_t t = logger_time_now();                                     \
+            if (LOGGER_TIME_ORIGIN == 0)                                        \
+                LOGGER_TIME_ORIGIN = t;                                         \
             if (isatty(STDOUT_FILENO))                                          \
                 fprintf(LOGGER_FD, "[%8lf] "                                    \
                                 "[TID=%d] "                                     \
                                 "[\033[1;37m" LOGGER_HEADER "\033[0m] "         \
                                 "[%s%s\033[0m] ",                               \
-                                LOGGER_TIME_ELAPSED,                            \
+                                logger_time_elapsed(t),                         \
                                 gettid(),                                       \
                                 LOGGER_PRINT_COLORS[LVL],                       \
                                 LOGGER_PRINT_HEADERS[LVL]);                     \
@@ -76,7 +393,7 @@ extern volatile uint64_t LOGGER_LAST_TIME;
                                 "[TID=%d] "                                     \
                                 "[" LOGGER_HEADER "] "                          \
                                 "[%s] ",                                        \
-                                LOGGER_TIME_ELAPSED,                            \
+                                logger_time_elapsed(t),                         \
                                 gettid(),                                       \
                                 LOGGER_PRINT_HEADERS[LVL]);                     \
             fprintf(LOGGER_FD, __VA_ARGS__);                                    \
@@ -92,6 +409,8 @@ extern volatile uint64_t LOGGER_LAST_TIME;
         }                                                                       \
     } while (0)
 
+# endif /* LOGGER_BINARY, LOGGER_ASYNC */
+
 # define LOGGER_NOT_SUPPORTED()   LOGGER_NOT_IMPLEMENTED_WARN("Not supported")
 # define LOGGER_NOT_IMPLEMENTED() LOGGER_NOT_IMPLEMENTED_WARN("Not implemented")
 
@@ -99,14 +418,30 @@ extern volatile uint64_t LOGGER_LAST_TIME;
     LOGGER_IMPL("'%s' at %s:%d in %s()",                                \
             S, __FILE__, __LINE__, __func__);
 
-# define LOGGER_INFO(...)  LOGGER_PRINT(LOGGER_PRINT_INFO_ID,  __VA_ARGS__)
-# define LOGGER_WARN(...)  LOGGER_PRINT(LOGGER_PRINT_WARN_ID,  __VA_ARGS__)
-# define LOGGER_ERROR(...) LOGGER_PRINT(LOGGER_PRINT_ERROR_ID, __VA_ARGS__)
-# define LOGGER_IMPL(...)  LOGGER_PRINT(LOGGER_PRINT_IMPL_ID,  __VA_ARGS__)
-# ifndef NDEBUG
+# if LOGGER_COMPILE_VERBOSE >= LOGGER_PRINT_ERROR_ID
+#  define LOGGER_ERROR(...) LOGGER_PRINT(LOGGER_PRINT_ERROR_ID, __VA_ARGS__)
+# else
+#  define LOGGER_ERROR(...) LOGGER_DISCARD(__VA_ARGS__)
+# endif
+# if LOGGER_COMPILE_VERBOSE >= LOGGER_PRINT_WARN_ID
+#  define LOGGER_WARN(...)  LOGGER_PRINT(LOGGER_PRINT_WARN_ID,  __VA_ARGS__)
+# else
+#  define LOGGER_WARN(...)  LOGGER_DISCARD(__VA_ARGS__)
+# endif
+# if LOGGER_COMPILE_VERBOSE >= LOGGER_PRINT_INFO_ID
+#  define LOGGER_INFO(...)  LOGGER_PRINT(LOGGER_PRINT_INFO_ID,  __VA_ARGS__)
+# else
+#  define LOGGER_INFO(...)  LOGGER_DISCARD(__VA_ARGS__)
+# endif
+# if LOGGER_COMPILE_VERBOSE >= LOGGER_PRINT_IMPL_ID
+#  define LOGGER_IMPL(...)  LOGGER_PRINT(LOGGER_PRINT_IMPL_ID,  __VA_ARGS__)
+# else
+#  define LOGGER_IMPL(...)  LOGGER_DISCARD(__VA_ARGS__)
+# endif
+# if LOGGER_COMPILE_VERBOSE >= LOGGER_PRINT_DEBUG_ID
 #  define LOGGER_DEBUG(...) LOGGER_PRINT(LOGGER_PRINT_DEBUG_ID, __VA_ARGS__)
 # else
-#  define LOGGER_DEBUG(...)
+#  define LOGGER_DEBUG(...) LOGGER_DISCARD(__VA_ARGS__)
 # endif
 # define LOGGER_FATAL(...) LOGGER_PRINT(LOGGER_PRINT_FATAL_ID, __VA_ARGS__)
 
@@ -0,0 +1,271 @@
+/**
+ *  End-to-end latency of dependent copies: a host wait between phases
+ *  against a copy graph (see copy-graph.h) run on the device timeline.
+ *
+ *  Host tiles of 'SX'x'SY' floats are side by side in a pitched buffer, as
+ *  in memcpy2d, and each tile has its own device buffer. Patterns:
+ *      - chain     H2D of tile 'i', then D2H of the device tile 'i' to the
+ *                  output tile 'i'
+ *      - shift     H2D of every tile (scatter), then D2H of the device tile
+ *                  'i + 1' to the output tile 'i' (gather), each D2H
+ *                  depending on the H2D of another tile
+ *  H2D of tile 'i' runs on engine 'i % ENGINES', its D2H on the next engine,
+ *  so that dependencies cross engines. Modes:
+ *      - phases    every H2D, a host wait on each, every D2H, a host wait
+ *                  on each (as memcpy2d does)
+ *      - graph     each D2H waits for its H2D event on the device, and the
+ *                  host only waits for the D2H
+ *  Reports the min and median time from the first append to the last
+ *  completion over 'REPS' runs, after an untimed one, and checks the
+ *  output tiles of the last run.
+ *
+ *  usage: copy-graph-bench [-x SX,...] [-y SY,...] [-n TILES,...] [-e ENGINES] [-r REPS]
+ */
+
+# include <getopt.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+# include <ze_api.h>
+
+# include <vector>
+
+# define LOGGER_HEADER "COPY-GRAPH-BENCH"
+# include "copy-graph.h"
+# include "logger-ze.h"
+# include "ze-device.h"
+# include "ze-event-pool.h"
+
+# define N_ENGINES_MAX 64
+
+typedef enum    pattern_e
+{
+    PATTERN_CHAIN,
+    PATTERN_SHIFT,
+    PATTERN_MAX
+}               pattern_t;
+
+static const char * PATTERN_NAMES[PATTERN_MAX] = {
+    "chain",
+    "shift"
+};
+
+typedef enum    sync_e
+{
+    SYNC_PHASES,
+    SYNC_GRAPH,
+    SYNC_MAX
+}               sync_t;
+
+static const char * SYNC_NAMES[SYNC_MAX] = {
+    "phases",
+    "graph"
+};
+
+static unsigned int REPETITIONS = 10;
+
+static inline uint64_t
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static int
+cmp(const void * a, const void * b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+// parse a comma-separated list of counts
+static std::vector<uint32_t>
+parse_list(const char * arg)
+{
+    std::vector<uint32_t> values;
+    char * s = strdup(arg);
+    for (char * tok = strtok(s, ",") ; tok ; tok = strtok(NULL, ","))
+        values.push_back(atoi(tok));
+    free(s);
+    return values;
+}
+
+// the device tile 'D2H' of output tile 'i' reads
+static unsigned int
+source_of(pattern_t pattern, unsigned int i, unsigned int ntiles)
+{
+    return pattern == PATTERN_SHIFT ? (i + 1) % ntiles : i;
+}
+
+/**
+ *  The H2D nodes (the first 'ntiles' ones) and the D2H nodes of a pattern,
+ *  into one graph with dependencies, or into two graphs without.
+ */
+static void
+build(
+    pattern_t pattern, sync_t sync,
+    uint32_t width, uint32_t height, unsigned int ntiles, unsigned int nengines,
+    char * in, char * out, char ** dev,
+    copy_graph_t * h2d, copy_graph_t * d2h
+) {
+    const size_t pitch = (size_t) ntiles * width;
+    for (unsigned int i = 0 ; i < ntiles ; ++i)
+        copy_graph_add(h2d, strided_region_2d(dev[i], in + i * width, width, pitch, width, height), i % nengines, {});
+
+    copy_graph_t * g = sync == SYNC_GRAPH ? h2d : d2h;
+    for (unsigned int i = 0 ; i < ntiles ; ++i)
+    {
+        const unsigned int src = source_of(pattern, i, ntiles);
+        const strided_region_t region = strided_region_2d(out + i * width, dev[src], pitch, width, width, height);
+        if (sync == SYNC_GRAPH)
+            copy_graph_add(g, region, (src + 1) % nengines, { src });
+        else
+            copy_graph_add(g, region, (src + 1) % nengines, {});
+    }
+}
+
+int
+main(int argc, char ** argv)
+{
+    std::vector<uint32_t> sxs    = { 64, 512, 4096 };
+    std::vector<uint32_t> sys    = { 512 };
+    std::vector<uint32_t> ntiles = { 1, 4, 16 };
+    unsigned int nengines = 2;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "x:y:n:e:r:")) != -1)
+    {
+        switch (opt)
+        {
+            case ('x'): sxs = parse_list(optarg); break ;
+            case ('y'): sys = parse_list(optarg); break ;
+            case ('n'): ntiles = parse_list(optarg); break ;
+            case ('e'): nengines = atoi(optarg); break ;
+            case ('r'): REPETITIONS = atoi(optarg); break ;
+            default:
+                fprintf(stderr, "usage: %s [-x SX,...] [-y SY,...] [-n TILES,...] [-e ENGINES] [-r REPS]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (REPETITIONS == 0)
+        REPETITIONS = 1;
+
+    LOGGER_INFO("Init");
+
+    ze_device_t ze;
+    ze_device_init(&ze);
+
+    ze_engine_t engines[N_ENGINES_MAX];
+    const unsigned int n = ze_device_engines(&ze, ZE_ENGINES_ALL, engines, N_ENGINES_MAX);
+    if (n == 0)
+        LOGGER_FATAL("No copy engine");
+    if (nengines == 0 || nengines > n)
+    {
+        LOGGER_WARN("`%u` engines requested, using `%u`", nengines, n);
+        nengines = n;
+    }
+
+    event_allocator_t events;
+    event_allocator_init(&events, ze.context, ze.device, 64, false);
+
+    const ze_device_mem_alloc_desc_t deviceDesc = {
+        .stype   = ZE_STRUCTURE_TYPE_DEVICE_MEM_ALLOC_DESC,
+        .pNext   = NULL,
+        .flags   = 0,
+        .ordinal = 0,
+    };
+
+    std::vector<uint64_t> ns(REPETITIONS);
+    printf("%6s %6s %6s %7s %-6s %-7s %12s %12s %10s\n",
+            "sx", "sy", "tiles", "engines", "pattern", "mode", "min (us)", "median (us)", "speedup");
+    for (uint32_t t : ntiles)
+    {
+        for (uint32_t sy : sys)
+        {
+            for (uint32_t sx : sxs)
+            {
+                const uint32_t width = sx * sizeof(float);
+                const size_t size_all = (size_t) t * width * sy;
+
+                float * in  = (float *) malloc(size_all);
+                float * out = (float *) malloc(size_all);
+                if (in == NULL || out == NULL)
+                    LOGGER_FATAL("Cannot allocate %zu bytes of host memory", size_all);
+                for (size_t k = 0 ; k < size_all / sizeof(float) ; ++k)
+                    in[k] = (float) k;
+                std::vector<char *> dev(t);
+                for (unsigned int i = 0 ; i < t ; ++i)
+                    ZE_SAFE_CALL(zeMemAllocDevice(ze.context, &deviceDesc, (size_t) width * sy, 64, ze.device, (void **) &dev[i]));
+
+                for (int p = 0 ; p < PATTERN_MAX ; ++p)
+                {
+                    uint64_t phases_median = 0;
+                    for (int m = 0 ; m < SYNC_MAX ; ++m)
+                    {
+                        copy_graph_t h2d, d2h;
+                        build((pattern_t) p, (sync_t) m, width, sy, t, nengines, (char *) in, (char *) out, dev.data(), &h2d, &d2h);
+
+                        for (int r = -1 ; r < (int) REPETITIONS ; ++r)
+                        {
+                            if (r == (int) REPETITIONS - 1)
+                                memset(out, 0, size_all);
+
+                            const uint64_t t0 = now();
+                            copy_graph_submit(&h2d, engines, &events);
+                            if (m == SYNC_PHASES)
+                            {
+                                copy_graph_wait(&h2d);
+                                copy_graph_submit(&d2h, engines, &events);
+                                copy_graph_wait(&d2h);
+                            }
+                            else
+                                copy_graph_wait(&h2d);
+                            const uint64_t t1 = now();
+
+                            copy_graph_release(&h2d, &events);
+                            copy_graph_release(&d2h, &events);
+                            if (r >= 0)
+                                ns[r] = t1 - t0;
+                        }
+                        qsort(ns.data(), REPETITIONS, sizeof(uint64_t), cmp);
+                        const uint64_t median = ns[REPETITIONS / 2];
+                        if (m == SYNC_PHASES)
+                            phases_median = median;
+
+                        // output tile 'i' is the input tile 'source_of(i)'
+                        for (unsigned int i = 0 ; i < t ; ++i)
+                        {
+                            const unsigned int src = source_of((pattern_t) p, i, t);
+                            for (uint32_t y = 0 ; y < sy ; ++y)
+                                if (memcmp((char *) out + (size_t) y * t * width + (size_t) i * width,
+                                           (char *) in  + (size_t) y * t * width + (size_t) src * width, width))
+                                    LOGGER_FATAL("FAILURE: `%s` `%s`, tile %u differs at row %u",
+                                            PATTERN_NAMES[p], SYNC_NAMES[m], i, y);
+                        }
+
+                        printf("%6u %6u %6u %7u %-6s %-7s %12.2lf %12.2lf %9.2lfx\n",
+                                sx, sy, t, nengines, PATTERN_NAMES[p], SYNC_NAMES[m],
+                                (double) ns[0] / 1e3, (double) median / 1e3, (double) phases_median / (double) median);
+                        fflush(stdout);
+                    }
+                }
+
+                for (unsigned int i = 0 ; i < t ; ++i)
+                    ZE_SAFE_CALL(zeMemFree(ze.context, dev[i]));
+                free(out);
+                free(in);
+            }
+        }
+    }
+
+    LOGGER_INFO("Deinit");
+
+    LOGGER_DEBUG("%u events in %zu pools", event_allocator_size(&events), events.pools.size());
+    event_allocator_deinit(&events);
+    ze_device_engines_release(engines, n);
+    ze_device_deinit(&ze);
+
+    return 0;
+}
@@ -0,0 +1,311 @@
+/**
+ *  Host cost of driving many concurrent tile transfers: a thread per batch
+ *  of tiles against coroutines resumed by a single reactor thread (see
+ *  ze-coro.h).
+ *
+ *  Each of the 'N' tiles of 'SX'x'SY' floats is copied to the device, then
+ *  back to another host buffer, tiles spread round-robin over 'ENGINES'
+ *  engines:
+ *      - threads       a thread per batch of 'BATCH' tiles, with its own
+ *                      immediate command list, appending the H2D copies of
+ *                      its tiles, 'zeEventHostSynchronize' on each, then
+ *                      the same for the D2H copies
+ *      - coro-poll     a coroutine per tile, 'co_await'-ing its H2D then its
+ *                      D2H copy, all resumed by one polling reactor thread
+ *      - coro-block    same, the reactor blocking on the oldest event when
+ *                      none signaled
+ *  Reports, over 'REPS' runs after an untimed one, the median time from the
+ *  start to the completion of all tiles, the median completion latency of
+ *  a tile (from the start), and the median process cpu time of a run.
+ *
+ *  usage: coro-bench [-n N,...] [-x SX] [-y SY] [-b BATCH] [-e ENGINES] [-r REPS]
+ */
+
+# include <getopt.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+# include <ze_api.h>
+
+# include <thread>
+# include <vector>
+
+# define LOGGER_HEADER "CORO-BENCH"
+# include "logger-ze.h"
+# include "ze-coro.h"
+# include "ze-device.h"
+# include "ze-event-pool.h"
+
+# define N_ENGINES_MAX 64
+
+typedef enum    mode_e
+{
+    MODE_THREADS,
+    MODE_CORO_POLL,
+    MODE_CORO_BLOCK,
+    MODE_MAX
+}               bench_mode_t;
+
+static const char * MODE_NAMES[MODE_MAX] = {
+    "threads",
+    "coro-poll",
+    "coro-block"
+};
+
+static unsigned int REPETITIONS = 10;
+
+static inline uint64_t
+now_clock(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static inline uint64_t
+now(void)
+{
+    return now_clock(CLOCK_MONOTONIC);
+}
+
+static int
+cmp(const void * a, const void * b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+// parse a comma-separated list of counts
+static std::vector<uint32_t>
+parse_list(const char * arg)
+{
+    std::vector<uint32_t> values;
+    char * s = strdup(arg);
+    for (char * tok = strtok(s, ",") ; tok ; tok = strtok(NULL, ","))
+        values.push_back(atoi(tok));
+    free(s);
+    return values;
+}
+
+// the H2D and D2H copies of each tile
+typedef struct  transfer_s
+{
+    strided_region_t h2d;
+    strided_region_t d2h;
+}               transfer_t;
+
+// copies the tiles [first, last) on 'list', a batch of the 'threads' mode
+static void
+batch(
+    event_allocator_t * events, ze_command_list_handle_t list,
+    const transfer_t * transfers, unsigned int first, unsigned int last,
+    uint64_t t0, uint64_t * latencies
+) {
+    std::vector<event_t *> signaled(last - first);
+    for (unsigned int i = first ; i < last ; ++i)
+    {
+        signaled[i - first] = event_alloc(events);
+        strided_copy_ze_region(list, &transfers[i].h2d, signaled[i - first]->event, 0, NULL);
+    }
+    for (unsigned int i = first ; i < last ; ++i)
+    {
+        ZE_SAFE_CALL(zeEventHostSynchronize(signaled[i - first]->event, UINT64_MAX));
+        event_free(events, signaled[i - first]);
+    }
+
+    for (unsigned int i = first ; i < last ; ++i)
+    {
+        signaled[i - first] = event_alloc(events);
+        strided_copy_ze_region(list, &transfers[i].d2h, signaled[i - first]->event, 0, NULL);
+    }
+    for (unsigned int i = first ; i < last ; ++i)
+    {
+        ZE_SAFE_CALL(zeEventHostSynchronize(signaled[i - first]->event, UINT64_MAX));
+        latencies[i] = now() - t0;
+        event_free(events, signaled[i - first]);
+    }
+}
+
+// the transfer of a tile, in the 'coro-*' modes
+static ze_task
+transfer(ze_reactor_t * r, ze_command_list_handle_t list, transfer_t t, uint64_t t0, uint64_t * latency)
+{
+    co_await copy_region(r, list, t.h2d);
+    co_await copy_region(r, list, t.d2h);
+    *latency = now() - t0;
+}
+
+int
+main(int argc, char ** argv)
+{
+    std::vector<uint32_t> counts = { 64, 1024, 4096 };
+    uint32_t sx = 64;
+    uint32_t sy = 16;
+    unsigned int batch_size = 16;
+    unsigned int nengines = 2;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:x:y:b:e:r:")) != -1)
+    {
+        switch (opt)
+        {
+            case ('n'): counts = parse_list(optarg); break ;
+            case ('x'): sx = atoi(optarg); break ;
+            case ('y'): sy = atoi(optarg); break ;
+            case ('b'): batch_size = atoi(optarg); break ;
+            case ('e'): nengines = atoi(optarg); break ;
+            case ('r'): REPETITIONS = atoi(optarg); break ;
+            default:
+                fprintf(stderr, "usage: %s [-n N,...] [-x SX] [-y SY] [-b BATCH] [-e ENGINES] [-r REPS]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (REPETITIONS == 0)
+        REPETITIONS = 1;
+    if (batch_size == 0)
+        batch_size = 1;
+
+    LOGGER_INFO("Init");
+
+    ze_device_t ze;
+    ze_device_init(&ze);
+
+    ze_engine_t engines[N_ENGINES_MAX];
+    const unsigned int n = ze_device_engines(&ze, ZE_ENGINES_ALL, engines, N_ENGINES_MAX);
+    if (n == 0)
+        LOGGER_FATAL("No copy engine");
+    if (nengines == 0 || nengines > n)
+    {
+        LOGGER_WARN("`%u` engines requested, using `%u`", nengines, n);
+        nengines = n;
+    }
+
+    event_allocator_t events;
+    event_allocator_init(&events, ze.context, ze.device, 64, false);
+
+    const ze_device_mem_alloc_desc_t deviceDesc = {
+        .stype   = ZE_STRUCTURE_TYPE_DEVICE_MEM_ALLOC_DESC,
+        .pNext   = NULL,
+        .flags   = 0,
+        .ordinal = 0,
+    };
+
+    const uint32_t width = sx * sizeof(float);
+    std::vector<uint64_t> wall_ns(REPETITIONS);
+    std::vector<uint64_t> latency_ns(REPETITIONS);
+    std::vector<uint64_t> cpu_ns(REPETITIONS);
+    printf("%8s %-10s %8s %12s %14s %12s\n", "tiles", "mode", "threads", "median (us)", "latency (us)", "cpu (us)");
+    for (uint32_t ntiles : counts)
+    {
+        // host tiles side by side, device tiles one after the other
+        const size_t pitch    = (size_t) ntiles * width;
+        const size_t size_all = pitch * sy;
+        float * in  = (float *) malloc(size_all);
+        float * out = (float *) malloc(size_all);
+        if (in == NULL || out == NULL)
+            LOGGER_FATAL("Cannot allocate %zu bytes of host memory", size_all);
+        for (size_t k = 0 ; k < size_all / sizeof(float) ; ++k)
+            in[k] = (float) k;
+        char * dev;
+        ZE_SAFE_CALL(zeMemAllocDevice(ze.context, &deviceDesc, size_all, 64, ze.device, (void **) &dev));
+
+        std::vector<transfer_t> transfers(ntiles);
+        for (unsigned int i = 0 ; i < ntiles ; ++i)
+        {
+            char * tile = dev + (size_t) i * width * sy;
+            transfers[i].h2d = strided_region_2d(tile, (char *) in + i * width, width, pitch, width, sy);
+            transfers[i].d2h = strided_region_2d((char *) out + i * width, tile, pitch, width, width, sy);
+        }
+        std::vector<uint64_t> latencies(ntiles);
+
+        for (int mode = 0 ; mode < MODE_MAX ; ++mode)
+        {
+            // 'threads': a command list per batch, created beforehand
+            const unsigned int nbatches = (ntiles + batch_size - 1) / batch_size;
+            std::vector<ze_command_list_handle_t> lists;
+            ze_reactor_t reactor;
+            if (mode == MODE_THREADS)
+            {
+                for (unsigned int b = 0 ; b < nbatches ; ++b)
+                    lists.push_back(ze_device_immediate_list(&ze, engines[b % nengines].ordinal, engines[b % nengines].index));
+            }
+            else
+                ze_reactor_init(&reactor, &events, mode == MODE_CORO_POLL ? ZE_REACTOR_POLL : ZE_REACTOR_BLOCK);
+
+            for (int r = -1 ; r < (int) REPETITIONS ; ++r)
+            {
+                if (r == (int) REPETITIONS - 1)
+                    memset(out, 0, size_all);
+
+                const uint64_t c0 = now_clock(CLOCK_PROCESS_CPUTIME_ID);
+                const uint64_t t0 = now();
+                if (mode == MODE_THREADS)
+                {
+                    std::vector<std::thread> threads;
+                    for (unsigned int b = 0 ; b < nbatches ; ++b)
+                    {
+                        const unsigned int first = b * batch_size;
+                        const unsigned int last  = first + batch_size < ntiles ? first + batch_size : ntiles;
+                        threads.emplace_back(batch, &events, lists[b], transfers.data(), first, last, t0, latencies.data());
+                    }
+                    for (std::thread & thread : threads)
+                        thread.join();
+                }
+                else
+                {
+                    std::vector<ze_task> tasks;
+                    tasks.reserve(ntiles);
+                    for (unsigned int i = 0 ; i < ntiles ; ++i)
+                    {
+                        tasks.push_back(transfer(&reactor, engines[i % nengines].list, transfers[i], t0, &latencies[i]));
+                        ze_task_start(&reactor, tasks.back());
+                    }
+                    for (ze_task & task : tasks)
+                        ze_task_join(task);
+                }
+                const uint64_t t1 = now();
+                const uint64_t c1 = now_clock(CLOCK_PROCESS_CPUTIME_ID);
+
+                if (r >= 0)
+                {
+                    qsort(latencies.data(), ntiles, sizeof(uint64_t), cmp);
+                    wall_ns[r]    = t1 - t0;
+                    latency_ns[r] = latencies[ntiles / 2];
+                    cpu_ns[r]     = c1 - c0;
+                }
+            }
+
+            if (mode == MODE_THREADS)
+                for (ze_command_list_handle_t list : lists)
+                    ZE_SAFE_CALL(zeCommandListDestroy(list));
+            else
+                ze_reactor_deinit(&reactor);
+
+            if (memcmp(in, out, size_all))
+                LOGGER_FATAL("FAILURE: `%s` with %u tiles, the tiles copied back differ", MODE_NAMES[mode], ntiles);
+
+            qsort(wall_ns.data(),    REPETITIONS, sizeof(uint64_t), cmp);
+            qsort(latency_ns.data(), REPETITIONS, sizeof(uint64_t), cmp);
+            qsort(cpu_ns.data(),     REPETITIONS, sizeof(uint64_t), cmp);
+            printf("%8u %-10s %8u %12.2lf %14.2lf %12.2lf\n",
+                    ntiles, MODE_NAMES[mode], mode == MODE_THREADS ? nbatches : 1,
+                    (double) wall_ns[REPETITIONS / 2] / 1e3,
+                    (double) latency_ns[REPETITIONS / 2] / 1e3,
+                    (double) cpu_ns[REPETITIONS / 2] / 1e3);
+            fflush(stdout);
+        }
+
+        ZE_SAFE_CALL(zeMemFree(ze.context, dev));
+        free(out);
+        free(in);
+    }
+
+    LOGGER_INFO("Deinit");
+
+    event_allocator_deinit(&events);
+    ze_device_engines_release(engines, n);
+    ze_device_deinit(&ze);
+
+    return 0;
+}
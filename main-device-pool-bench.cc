@@ -0,0 +1,143 @@
+/**
+ *  Latency of device tile allocations, one 'zeMemAllocDevice' per tile
+ *  versus tiles carved out of slabs (see ze-device-pool.h).
+ *
+ *  For each tile size and each kind of device memory, a fresh pool
+ *  allocates 'N_TILES' tiles then frees them, 'REPETITIONS' times. The first
+ *  round ('cold') pays for the slabs, the next ones reuse freed tiles as a
+ *  benchmark iterating over the same configuration would.
+ *
+ *  Reports the time per tile of the cold allocations, and the median time
+ *  per tile of the allocations and frees of the next rounds.
+ *
+ *  usage: device-pool-bench [-s SIZE,...] [-n N_TILES] [-r REPS]
+ */
+
+# include <getopt.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+# include <ze_api.h>
+
+# include <vector>
+
+# define LOGGER_HEADER "DEVICE-POOL-BENCH"
+# include "logger-ze.h"
+# include "ze-device.h"
+# include "ze-device-pool.h"
+
+# define SLAB_SIZE  (256 * 1024 * 1024)
+# define ALIGNMENT  (64 * 1024)
+
+static unsigned int N_TILES = 64;
+static unsigned int REPETITIONS = 10;
+
+static inline uint64_t
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static int
+cmp(const void * a, const void * b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+// parse a comma-separated list of sizes
+static std::vector<size_t>
+parse_list(const char * arg)
+{
+    std::vector<size_t> values;
+    char * s = strdup(arg);
+    for (char * tok = strtok(s, ",") ; tok ; tok = strtok(NULL, ","))
+        values.push_back(strtoull(tok, NULL, 0));
+    free(s);
+    return values;
+}
+
+int
+main(int argc, char ** argv)
+{
+    std::vector<size_t> sizes = { 4096, 65536, 1048576, 16777216 };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:r:")) != -1)
+    {
+        switch (opt)
+        {
+            case ('s'): sizes = parse_list(optarg); break ;
+            case ('n'): N_TILES = atoi(optarg); break ;
+            case ('r'): REPETITIONS = atoi(optarg); break ;
+            default:
+                fprintf(stderr, "usage: %s [-s SIZE,...] [-n N_TILES] [-r REPS]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (N_TILES == 0)
+        N_TILES = 1;
+    if (REPETITIONS < 2)
+        REPETITIONS = 2;
+
+    LOGGER_INFO("Init");
+
+    ze_device_t ze;
+    ze_device_init(&ze);
+
+    std::vector<void *> tiles(N_TILES);
+    std::vector<uint64_t> alloc_ns(REPETITIONS - 1);
+    std::vector<uint64_t> free_ns(REPETITIONS - 1);
+
+    printf("%12s %8s %-6s %16s %16s %16s %6s\n",
+            "size", "tiles", "kind", "cold (ns/tile)", "alloc (ns/tile)", "free (ns/tile)", "slabs");
+    for (size_t size : sizes)
+    {
+        for (int kind = 0 ; kind < DEVICE_POOL_MAX ; ++kind)
+        {
+            device_pool_t pool;
+            device_pool_init(&pool, (device_pool_kind_t) kind, ze.context, ze.device, SLAB_SIZE, ALIGNMENT);
+
+            uint64_t cold = 0;
+            for (unsigned int r = 0 ; r < REPETITIONS ; ++r)
+            {
+                const uint64_t t0 = now();
+                for (unsigned int i = 0 ; i < N_TILES ; ++i)
+                    tiles[i] = device_pool_alloc(&pool, size);
+                const uint64_t t1 = now();
+                for (unsigned int i = 0 ; i < N_TILES ; ++i)
+                    device_pool_free(&pool, tiles[i], size);
+                const uint64_t t2 = now();
+
+                if (r == 0)
+                    cold = t1 - t0;
+                else
+                {
+                    alloc_ns[r - 1] = t1 - t0;
+                    free_ns[r - 1]  = t2 - t1;
+                }
+            }
+            qsort(alloc_ns.data(), alloc_ns.size(), sizeof(uint64_t), cmp);
+            qsort(free_ns.data(),  free_ns.size(),  sizeof(uint64_t), cmp);
+
+            printf("%12zu %8u %-6s %16.1lf %16.1lf %16.1lf %6zu\n",
+                    size, N_TILES, DEVICE_POOL_NAMES[kind],
+                    (double) cold / N_TILES,
+                    (double) alloc_ns[alloc_ns.size() / 2] / N_TILES,
+                    (double) free_ns[free_ns.size() / 2] / N_TILES,
+                    pool.slabs.size());
+            fflush(stdout);
+
+            device_pool_deinit(&pool);
+        }
+    }
+
+    LOGGER_INFO("Deinit");
+
+    ze_device_deinit(&ze);
+
+    return 0;
+}
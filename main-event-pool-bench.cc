@@ -0,0 +1,247 @@
+/**
+ *  Per-copy event overhead with many copies in flight.
+ *
+ *  A round appends 'N' small copies, each signaling its own event, then
+ *  waits for every event. Events come from:
+ *      - static    a single pool of 'N' events created beforehand, each
+ *                  event host-reset before its copy (as memcpy2d used to)
+ *      - dynamic   an 'event_allocator_t' (see ze-event-pool.h) growing
+ *                  from 64 events, events freed once their copy completed
+ *      - counter   same, with counter-based events on an in-order list,
+ *                  never host-reset (if the driver offers them)
+ *
+ *  For each number of outstanding copies, reports the median time per copy
+ *  spent getting and releasing events, and the median time per copy of a
+ *  round. Rounds are repeated 'REPS' times after an untimed one, which
+ *  grows the dynamic allocators.
+ *
+ *  usage: event-pool-bench [-n N,...] [-r REPS]
+ */
+
+# include <getopt.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+# include <ze_api.h>
+
+# include <vector>
+
+# define LOGGER_HEADER "EVENT-POOL-BENCH"
+# include "logger-ze.h"
+# include "ze-device.h"
+# include "ze-event-pool.h"
+
+// bytes per copy
+# define COPY_SIZE 64
+
+typedef enum    event_mode_e
+{
+    EVENT_STATIC,
+    EVENT_DYNAMIC,
+    EVENT_COUNTER,
+    EVENT_MAX
+}               event_mode_t;
+
+static const char * EVENT_NAMES[EVENT_MAX] = {
+    "static",
+    "dynamic",
+    "counter"
+};
+
+static unsigned int REPETITIONS = 5;
+
+static inline uint64_t
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static int
+cmp(const void * a, const void * b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+// parse a comma-separated list of counts
+static std::vector<uint32_t>
+parse_list(const char * arg)
+{
+    std::vector<uint32_t> values;
+    char * s = strdup(arg);
+    for (char * tok = strtok(s, ",") ; tok ; tok = strtok(NULL, ","))
+        values.push_back(atoi(tok));
+    free(s);
+    return values;
+}
+
+int
+main(int argc, char ** argv)
+{
+    std::vector<uint32_t> counts = { 64, 1024, 65536 };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:r:")) != -1)
+    {
+        switch (opt)
+        {
+            case ('n'): counts = parse_list(optarg); break ;
+            case ('r'): REPETITIONS = atoi(optarg); break ;
+            default:
+                fprintf(stderr, "usage: %s [-n N,...] [-r REPS]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (REPETITIONS == 0)
+        REPETITIONS = 1;
+
+    LOGGER_INFO("Init");
+
+    ze_device_t ze;
+    ze_device_init(&ze);
+
+    ze_engine_t engine;
+    if (ze_device_engines(&ze, ZE_ENGINES_ALL, &engine, 1) == 0)
+        LOGGER_FATAL("No copy engine");
+    ze_command_list_handle_t in_order = ze_device_immediate_list(&ze, engine.ordinal, engine.index,
+            ZE_COMMAND_QUEUE_FLAG_EXPLICIT_ONLY | ZE_COMMAND_QUEUE_FLAG_IN_ORDER);
+
+    const bool counter_based = event_counter_based_supported(ze.driver);
+    if (!counter_based)
+        LOGGER_WARN("The driver has no counter-based events, skipping the `counter` mode");
+
+    uint32_t max = 0;
+    for (uint32_t n : counts)
+        max = n > max ? n : max;
+
+    // a source and a destination slot per copy
+    char * hst_mem = (char *) malloc((size_t) max * COPY_SIZE);
+    if (hst_mem == NULL)
+        LOGGER_FATAL("Cannot allocate host memory");
+    memset(hst_mem, 1, (size_t) max * COPY_SIZE);
+    const ze_device_mem_alloc_desc_t deviceDesc = {
+        .stype   = ZE_STRUCTURE_TYPE_DEVICE_MEM_ALLOC_DESC,
+        .pNext   = NULL,
+        .flags   = 0,
+        .ordinal = 0,
+    };
+    char * dev_mem;
+    ZE_SAFE_CALL(zeMemAllocDevice(ze.context, &deviceDesc, (size_t) max * COPY_SIZE, 64, ze.device, (void **) &dev_mem));
+
+    std::vector<uint64_t> event_ns(REPETITIONS);
+    std::vector<uint64_t> total_ns(REPETITIONS);
+    printf("%10s %-8s %6s %10s %18s %18s\n", "copies", "events", "pools", "created", "event (ns/copy)", "median (ns/copy)");
+    for (uint32_t n : counts)
+    {
+        for (int mode = 0 ; mode < EVENT_MAX ; ++mode)
+        {
+            if (mode == EVENT_COUNTER && !counter_based)
+                continue ;
+
+            ze_command_list_handle_t list = mode == EVENT_COUNTER ? in_order : engine.list;
+
+            // 'static': a pool of 'n' events
+            ze_event_pool_handle_t pool = NULL;
+            std::vector<ze_event_handle_t> pooled;
+            event_allocator_t allocator;
+            if (mode == EVENT_STATIC)
+            {
+                const ze_event_pool_desc_t poolDesc = {
+                    .stype  = ZE_STRUCTURE_TYPE_EVENT_POOL_DESC,
+                    .pNext  = NULL,
+                    .flags  = ZE_EVENT_POOL_FLAG_HOST_VISIBLE,
+                    .count  = n
+                };
+                ZE_SAFE_CALL(zeEventPoolCreate(ze.context, &poolDesc, 1, &ze.device, &pool));
+                pooled.resize(n);
+                for (uint32_t i = 0 ; i < n ; ++i)
+                {
+                    const ze_event_desc_t eventDesc = {
+                        .stype  = ZE_STRUCTURE_TYPE_EVENT_DESC,
+                        .pNext  = NULL,
+                        .index  = i,
+                        .signal = ZE_EVENT_SCOPE_FLAG_HOST,
+                        .wait   = ZE_EVENT_SCOPE_FLAG_HOST,
+                    };
+                    ZE_SAFE_CALL(zeEventCreate(pool, &eventDesc, &pooled[i]));
+                }
+            }
+            else
+                event_allocator_init(&allocator, ze.context, ze.device, 64, mode == EVENT_COUNTER);
+
+            std::vector<event_t *> allocated(n);
+            std::vector<ze_event_handle_t> signaled(n);
+            for (int r = -1 ; r < (int) REPETITIONS ; ++r)
+            {
+                uint64_t events = 0;
+                const uint64_t t0 = now();
+                for (uint32_t i = 0 ; i < n ; ++i)
+                {
+                    const uint64_t e0 = now();
+                    if (mode == EVENT_STATIC)
+                    {
+                        ZE_SAFE_CALL(zeEventHostReset(pooled[i]));
+                        signaled[i] = pooled[i];
+                    }
+                    else
+                    {
+                        allocated[i] = event_alloc(&allocator);
+                        signaled[i] = allocated[i]->event;
+                    }
+                    events += now() - e0;
+
+                    ZE_SAFE_CALL(zeCommandListAppendMemoryCopy(list, dev_mem + (size_t) i * COPY_SIZE,
+                                hst_mem + (size_t) i * COPY_SIZE, COPY_SIZE, signaled[i], 0, NULL));
+                }
+                for (uint32_t i = 0 ; i < n ; ++i)
+                    ZE_SAFE_CALL(zeEventHostSynchronize(signaled[i], UINT64_MAX));
+                if (mode != EVENT_STATIC)
+                {
+                    const uint64_t e0 = now();
+                    for (uint32_t i = 0 ; i < n ; ++i)
+                        event_free(&allocator, allocated[i]);
+                    events += now() - e0;
+                }
+                const uint64_t t1 = now();
+
+                if (r >= 0)
+                {
+                    event_ns[r] = events;
+                    total_ns[r] = t1 - t0;
+                }
+            }
+            qsort(event_ns.data(), REPETITIONS, sizeof(uint64_t), cmp);
+            qsort(total_ns.data(), REPETITIONS, sizeof(uint64_t), cmp);
+
+            printf("%10u %-8s %6zu %10u %18.1lf %18.1lf\n",
+                    n, EVENT_NAMES[mode],
+                    mode == EVENT_STATIC ? (size_t) 1 : allocator.pools.size(),
+                    mode == EVENT_STATIC ? n : event_allocator_size(&allocator),
+                    (double) event_ns[REPETITIONS / 2] / n,
+                    (double) total_ns[REPETITIONS / 2] / n);
+            fflush(stdout);
+
+            if (mode == EVENT_STATIC)
+            {
+                for (uint32_t i = 0 ; i < n ; ++i)
+                    ZE_SAFE_CALL(zeEventDestroy(pooled[i]));
+                ZE_SAFE_CALL(zeEventPoolDestroy(pool));
+            }
+            else
+                event_allocator_deinit(&allocator);
+        }
+    }
+
+    LOGGER_INFO("Deinit");
+
+    ZE_SAFE_CALL(zeMemFree(ze.context, dev_mem));
+    free(hst_mem);
+    ZE_SAFE_CALL(zeCommandListDestroy(in_order));
+    ze_device_engines_release(&engine, 1);
+    ze_device_deinit(&ze);
+
+    return 0;
+}
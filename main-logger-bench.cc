@@ -0,0 +1,127 @@
+/**
+ *  Logger throughput and caller latency.
+ *
+ *  For 1, 2, 4, ... up to MAX_THREADS threads, each thread logs
+ *  N_MESSAGES messages, measuring the time spent in each `LOGGER_INFO` call.
+ *  Reports the number of messages per second (including the time to write
+ *  every messages, so that the asynchronous backend is fairly accounted)
+ *  and the p50/p99 caller latency.
+ *
+ *  Built three times (see Makefile): synchronous, LOGGER_ASYNC=1 and
+ *  LOGGER_BINARY=1. Text logs go to stderr, results to stdout: run with
+ *  `2>/dev/null`. Binary logs go to `$LOGGER_BINARY_FILE`.
+ */
+
+# include <assert.h>
+# include <pthread.h>
+# include <stdio.h>
+# include <stdlib.h>
+# include <time.h>
+
+# define LOGGER_HEADER "BENCH"
+# include "logger.h"
+
+static unsigned int N_MESSAGES;
+
+static pthread_barrier_t barrier;
+
+// per-thread latencies, in ns
+static uint64_t ** latencies;
+
+static inline uint64_t
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static int
+cmp(const void * a, const void * b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static void *
+run(void * args)
+{
+    uint64_t * lat = (uint64_t *) args;
+    pthread_barrier_wait(&barrier);
+    for (unsigned int i = 0 ; i < N_MESSAGES ; ++i)
+    {
+        uint64_t t0 = now();
+        LOGGER_INFO("message %u of %u, value=%lf", i, N_MESSAGES, (double) i / N_MESSAGES);
+        uint64_t tf = now();
+        lat[i] = tf - t0;
+    }
+    pthread_barrier_wait(&barrier);
+    return NULL;
+}
+
+int
+main(int argc, char ** argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s [MAX_THREADS] [N_MESSAGES]\n", argv[0]);
+        return 1;
+    }
+
+    const unsigned int max_threads = atoi(argv[1]);
+    N_MESSAGES = atoi(argv[2]);
+
+    printf("%-8s %8s %16s %12s %12s\n", "backend", "threads", "msg/s", "p50 (ns)", "p99 (ns)");
+
+    for (unsigned int nthreads = 1 ; nthreads <= max_threads ; nthreads *= 2)
+    {
+        pthread_t threads[nthreads];
+        latencies = (uint64_t **) malloc(sizeof(uint64_t *) * nthreads);
+        assert(latencies);
+
+        pthread_barrier_init(&barrier, NULL, nthreads + 1);
+        for (unsigned int i = 0 ; i < nthreads ; ++i)
+        {
+            latencies[i] = (uint64_t *) malloc(sizeof(uint64_t) * N_MESSAGES);
+            assert(latencies[i]);
+            pthread_create(threads + i, NULL, run, latencies[i]);
+        }
+
+        pthread_barrier_wait(&barrier);
+        uint64_t t0 = now();
+        pthread_barrier_wait(&barrier);
+        # if LOGGER_ASYNC || LOGGER_BINARY
+        logger_async_drain();
+        # endif
+        fflush(LOGGER_FD);
+        uint64_t tf = now();
+
+        for (unsigned int i = 0 ; i < nthreads ; ++i)
+            pthread_join(threads[i], NULL);
+        pthread_barrier_destroy(&barrier);
+
+        // gather latencies
+        const size_t n = (size_t) nthreads * N_MESSAGES;
+        uint64_t * all = (uint64_t *) malloc(sizeof(uint64_t) * n);
+        assert(all);
+        for (unsigned int i = 0 ; i < nthreads ; ++i)
+        {
+            for (unsigned int j = 0 ; j < N_MESSAGES ; ++j)
+                all[i * N_MESSAGES + j] = latencies[i][j];
+            free(latencies[i]);
+        }
+        free(latencies);
+        qsort(all, n, sizeof(uint64_t), cmp);
+
+        const double rate = (double) n / ((double) (tf - t0) / 1e9);
+        printf("%-8s %8u %16.0lf %12lu %12lu\n",
+                LOGGER_BINARY ? "binary" : LOGGER_ASYNC ? "async" : "sync",
+                nthreads, rate, all[n / 2], all[(n * 99) / 100]);
+        fflush(stdout);
+
+        free(all);
+    }
+
+    return 0;
+}
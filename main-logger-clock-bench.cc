@@ -0,0 +1,71 @@
+/**
+ *  Cost of a logger record timestamp, for both time sources:
+ *      - 'tsc'         : `rdtsc`, as used when the TSC is invariant
+ *      - 'monotonic'   : `clock_gettime(CLOCK_MONOTONIC)`, the fallback
+ *  and of the conversion of a timestamp to the elapsed time printed.
+ *
+ *  usage: logger-clock-bench [N_ITERATIONS]
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+
+# define LOGGER_HEADER "BENCH"
+# include "logger.h"
+
+// prevent the compiler from removing the timed calls
+static volatile uint64_t sink;
+
+static double
+bench_now(unsigned int n)
+{
+    uint64_t t0 = logger_time_monotonic();
+    for (unsigned int i = 0 ; i < n ; ++i)
+        sink = logger_time_now();
+    uint64_t tf = logger_time_monotonic();
+    return (double) (tf - t0) / n;
+}
+
+static double
+bench_elapsed(unsigned int n)
+{
+    volatile double elapsed;
+    uint64_t t0 = logger_time_monotonic();
+    for (unsigned int i = 0 ; i < n ; ++i)
+        elapsed = logger_time_elapsed(logger_time_now());
+    uint64_t tf = logger_time_monotonic();
+    (void) elapsed;
+    return (double) (tf - t0) / n;
+}
+
+int
+main(int argc, char ** argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s [N_ITERATIONS]\n", argv[0]);
+        return 1;
+    }
+
+    const unsigned int n = atoi(argv[1]);
+    const int tsc = LOGGER_TIME_TSC;
+
+    if (!tsc)
+        LOGGER_WARN("TSC is not invariant (or `LOGGER_CLOCK=monotonic`): only measuring the fallback");
+    else
+        LOGGER_INFO("TSC calibrated at %lf ns per tick", LOGGER_TIME_NS_PER_TICK);
+
+    LOGGER_TIME_ORIGIN = logger_time_now();
+
+    printf("%-12s %16s %16s\n", "source", "now (ns)", "elapsed (ns)");
+    if (tsc)
+        printf("%-12s %16.2lf %16.2lf\n", "tsc", bench_now(n), bench_elapsed(n));
+
+    // the fallback, ticks are then nanoseconds
+    LOGGER_TIME_TSC = 0;
+    LOGGER_TIME_NS_PER_TICK = 1.0;
+    LOGGER_TIME_ORIGIN = logger_time_now();
+    printf("%-12s %16.2lf %16.2lf\n", "monotonic", bench_now(n), bench_elapsed(n));
+
+    return 0;
+}
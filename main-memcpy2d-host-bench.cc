@@ -0,0 +1,168 @@
+/**
+ *  Host 2D region copy bandwidth (see memcpy2d-host.h).
+ *
+ *  For each tile shape, copies one tile out of a host array of 'N_TILES'
+ *  continuous tiles into a continuous tile (the H2D layout of
+ *  'main-memcpy2d.cc'), with:
+ *      - 'memcpy'  one 'memcpy' per row, the reference
+ *      - every supported instruction set, with and without non-temporal
+ *        stores, on 1 thread and on all OpenMP threads
+ *      - 'auto'    'memcpy2d_host', as the copy path would call it
+ *
+ *  Reports the best time out of N_REPETITIONS and the bandwidth, in bytes
+ *  copied per second: compare it with the device round trip of
+ *  'memcpy2d' to know when packing tiles on the host is worth it.
+ *
+ *  usage: memcpy2d-host-bench [N_REPETITIONS]
+ */
+
+# include <assert.h>
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+
+# include <omp.h>
+
+# include "memcpy2d-host.h"
+
+// number of tiles of the source array
+# define N_TILES 4
+
+// tile shapes, in bytes x rows
+static const uint32_t SHAPES[][2] = {
+    {    64,   64 },
+    {   256,  256 },
+    {  1024, 1024 },
+    {  2048, 2048 },
+    {  8192, 2048 },
+    { 65536,   64 },
+    {    64, 65536 },
+    {  8192, 8192 }
+};
+
+static unsigned int N_REPETITIONS;
+
+static inline uint64_t
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static void
+memcpy2d_rows(
+    void * dst, const void * src,
+    const size_t dst_pitch, const size_t src_pitch,
+    uint32_t width, uint32_t height,
+    uint32_t dst_ox, uint32_t src_ox
+) {
+    for (uint32_t y = 0 ; y < height ; ++y)
+        memcpy((char *) dst + dst_ox + y * dst_pitch, (const char *) src + src_ox + y * src_pitch, width);
+}
+
+// best time of 'N_REPETITIONS' copies of the tile 1, in ns
+template <typename F>
+static uint64_t
+bench(F f, char * dst, const char * src, uint32_t width, uint32_t height)
+{
+    const size_t dst_pitch = width;
+    const size_t src_pitch = (size_t) N_TILES * width;
+    const uint32_t src_ox  = width;
+
+    // warmup, and check
+    memset(dst, 0, (size_t) width * height);
+    f(dst, src, dst_pitch, src_pitch, width, height, 0, src_ox);
+    for (uint32_t y = 0 ; y < height ; ++y)
+    {
+        if (memcmp(dst + y * dst_pitch, src + y * src_pitch + src_ox, width))
+        {
+            fprintf(stderr, "Wrong copy of row `%u` (%u x %u)\n", y, width, height);
+            abort();
+        }
+    }
+
+    uint64_t best = UINT64_MAX;
+    for (unsigned int r = 0 ; r < N_REPETITIONS ; ++r)
+    {
+        uint64_t t0 = now();
+        f(dst, src, dst_pitch, src_pitch, width, height, 0, src_ox);
+        uint64_t tf = now();
+        if (tf - t0 < best)
+            best = tf - t0;
+    }
+    return best;
+}
+
+static void
+report(const char * name, int nt, int nthreads, uint32_t width, uint32_t height, uint64_t ns)
+{
+    const double size = (double) width * height;
+    printf("%8u %8u %-8s %4d %8d %12.2lf %10.2lf\n", width, height, name, nt, nthreads,
+            (double) ns / 1e3, size / (double) ns);
+    fflush(stdout);
+}
+
+int
+main(int argc, char ** argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s [N_REPETITIONS]\n", argv[0]);
+        return 1;
+    }
+
+    N_REPETITIONS = atoi(argv[1]);
+    const int max_threads = omp_get_max_threads();
+
+    printf("%8s %8s %-8s %4s %8s %12s %10s\n", "width", "height", "isa", "nt", "threads", "time (us)", "GB/s");
+    for (unsigned int k = 0 ; k < sizeof(SHAPES) / sizeof(*SHAPES) ; ++k)
+    {
+        const uint32_t width  = SHAPES[k][0];
+        const uint32_t height = SHAPES[k][1];
+        const size_t size = (size_t) width * height;
+
+        char * src = (char *) aligned_alloc(64, N_TILES * size);
+        char * dst = (char *) aligned_alloc(64, size);
+        assert(src && dst);
+
+        // first touch on all threads
+        # pragma omp parallel for schedule(static)
+        for (size_t i = 0 ; i < N_TILES * size ; ++i)
+            src[i] = (char) (i * 7);
+        # pragma omp parallel for schedule(static)
+        for (size_t i = 0 ; i < size ; ++i)
+            dst[i] = 0;
+
+        report("memcpy", 0, 1, width, height, bench(memcpy2d_rows, dst, src, width, height));
+
+        for (int isa = 0 ; isa < MEMCPY2D_HOST_ISA_MAX ; ++isa)
+        {
+            if (!memcpy2d_host_isa_supported((memcpy2d_host_isa_t) isa))
+                continue ;
+
+            for (int nt = 0 ; nt <= 1 ; ++nt)
+            {
+                for (int nthreads = 1 ; ; nthreads = max_threads)
+                {
+                    auto f = [=] (void * d, const void * s, size_t dp, size_t sp, uint32_t w, uint32_t h, uint32_t dox, uint32_t sox) {
+                        memcpy2d_host_ex((memcpy2d_host_isa_t) isa, nt, nthreads, d, s, dp, sp, w, h, dox, sox);
+                    };
+                    report(MEMCPY2D_HOST_ISA_NAMES[isa], nt, nthreads, width, height, bench(f, dst, src, width, height));
+                    if (nthreads == max_threads)
+                        break ;
+                }
+            }
+        }
+
+        report("auto", size >= MEMCPY2D_HOST_NT_THRESHOLD,
+                size >= MEMCPY2D_HOST_OMP_THRESHOLD ? max_threads : 1,
+                width, height, bench(memcpy2d_host, dst, src, width, height));
+
+        free(src);
+        free(dst);
+    }
+
+    return 0;
+}
@@ -0,0 +1,327 @@
+/**
+ *  Submission cost of a repeated batch of tile copies, appended again at each
+ *  round to an immediate command list, or recorded once in a regular command
+ *  list and replayed.
+ *
+ *  A round copies 'N_TILES' tiles of 'SY' rows of 'SX' floats to the device
+ *  (H2D), then back to the host (D2H), with a barrier in between:
+ *      - immediate     each round appends the '2 * N_TILES' copies to an
+ *                      immediate command list, and waits for an event
+ *                      signaled by a final barrier
+ *      - replay        the round is recorded once into a regular command
+ *                      list, closed, and each round is a single
+ *                      'zeCommandQueueExecuteCommandLists' with a fence
+ *
+ *  For each tile shape, reports the recording time, the median host time
+ *  spent submitting a round divided by its number of copies, and the median
+ *  time of a round until its completion.
+ *
+ *  usage: memcpy2d-replay [-x SX,...] [-y SY,...] [-n N_TILES] [-a ALLOC] [-r REPS]
+ */
+
+# include <getopt.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+# include <ze_api.h>
+
+# include <vector>
+
+# define LOGGER_HEADER "MEMCPY2D-REPLAY"
+# include "logger-ze.h"
+# include "ze-device.h"
+# include "ze-host-alloc.h"
+
+// type of the data copied
+# define TYPE float
+
+typedef enum    list_mode_e
+{
+    LIST_IMMEDIATE,
+    LIST_REPLAY,
+    LIST_MAX
+}               list_mode_t;
+
+static const char * LIST_NAMES[LIST_MAX] = {
+    "immediate",
+    "replay"
+};
+
+static unsigned int N_TILES = 64;
+static unsigned int REPETITIONS = 100;
+
+typedef struct  timing_s
+{
+    uint64_t submit;    // host time in the submission calls
+    uint64_t total;     // until the round completed
+}               timing_t;
+
+static inline uint64_t
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static int
+cmp(const void * a, const void * b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+// parse a comma-separated list of sizes
+static std::vector<uint32_t>
+parse_list(const char * arg)
+{
+    std::vector<uint32_t> values;
+    char * s = strdup(arg);
+    for (char * tok = strtok(s, ",") ; tok ; tok = strtok(NULL, ","))
+        values.push_back(atoi(tok));
+    free(s);
+    return values;
+}
+
+/**
+ *  Append a round: H2D of every tile, a barrier, D2H of every tile, and a
+ *  final barrier signaling 'done'.
+ */
+static void
+append_round(
+    ze_command_list_handle_t list,
+    char * hst_in, char * hst_out, char * dev_mem,
+    uint32_t sx, uint32_t sy,
+    ze_event_handle_t done
+) {
+    const size_t width = sx * sizeof(TYPE);
+    const size_t size  = width * sy;
+    const ze_copy_region_t region = {
+        .originX = 0,
+        .originY = 0,
+        .originZ = 0,
+        .width   = (uint32_t) width,
+        .height  = sy,
+        .depth   = 0
+    };
+
+    for (unsigned int i = 0 ; i < N_TILES ; ++i)
+    {
+        ZE_SAFE_CALL(
+            zeCommandListAppendMemoryCopyRegion(
+                list,
+                dev_mem + i * size, &region, width, 0,
+                hst_in  + i * size, &region, width, 0,
+                NULL, 0, NULL
+            )
+        );
+    }
+    ZE_SAFE_CALL(zeCommandListAppendBarrier(list, NULL, 0, NULL));
+    for (unsigned int i = 0 ; i < N_TILES ; ++i)
+    {
+        ZE_SAFE_CALL(
+            zeCommandListAppendMemoryCopyRegion(
+                list,
+                hst_out + i * size, &region, width, 0,
+                dev_mem + i * size, &region, width, 0,
+                NULL, 0, NULL
+            )
+        );
+    }
+    ZE_SAFE_CALL(zeCommandListAppendBarrier(list, done, 0, NULL));
+}
+
+int
+main(int argc, char ** argv)
+{
+    std::vector<uint32_t> sxs = { 16, 64, 256, 1024, 4096 };
+    std::vector<uint32_t> sys = { 64 };
+    host_alloc_kind_t alloc = HOST_ALLOC_MALLOC;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "x:y:n:a:r:")) != -1)
+    {
+        switch (opt)
+        {
+            case ('x'): sxs = parse_list(optarg); break ;
+            case ('y'): sys = parse_list(optarg); break ;
+            case ('n'): N_TILES = atoi(optarg); break ;
+            case ('r'): REPETITIONS = atoi(optarg); break ;
+            case ('a'):
+            {
+                int a;
+                for (a = 0 ; a < HOST_ALLOC_MAX ; ++a)
+                    if (strcmp(optarg, HOST_ALLOC_NAMES[a]) == 0)
+                        break ;
+                if (a == HOST_ALLOC_MAX)
+                    LOGGER_FATAL("Unknown host allocator `%s`", optarg);
+                alloc = (host_alloc_kind_t) a;
+                break ;
+            }
+            default:
+                fprintf(stderr, "usage: %s [-x SX,...] [-y SY,...] [-n N_TILES] [-a ALLOC] [-r REPS]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (N_TILES == 0)
+        N_TILES = 1;
+    if (REPETITIONS == 0)
+        REPETITIONS = 1;
+
+    //////////////
+    //  INIT    //
+    //////////////
+
+    LOGGER_INFO("Init");
+
+    ze_device_t ze;
+    ze_device_init(&ze);
+
+    // the same engine, through an immediate list, or a queue and a regular list
+    ze_engine_t engine;
+    if (ze_device_engines(&ze, ZE_ENGINES_ALL, &engine, 1) == 0)
+        LOGGER_FATAL("No copy engine");
+    LOGGER_INFO("Copies on engine (%u, %u)", engine.ordinal, engine.index);
+    ze_command_queue_handle_t queue = ze_device_queue(&ze, engine.ordinal, engine.index);
+    ze_command_list_handle_t recorded = ze_device_list(&ze, engine.ordinal);
+
+    ze_fence_handle_t fence;
+    const ze_fence_desc_t fenceDesc = {
+        .stype = ZE_STRUCTURE_TYPE_FENCE_DESC,
+        .pNext = NULL,
+        .flags = 0
+    };
+    ZE_SAFE_CALL(zeFenceCreate(queue, &fenceDesc, &fence));
+
+    ze_event_pool_handle_t pool;
+    const ze_event_pool_desc_t poolDesc = {
+        .stype  = ZE_STRUCTURE_TYPE_EVENT_POOL_DESC,
+        .pNext  = NULL,
+        .flags  = ZE_EVENT_POOL_FLAG_HOST_VISIBLE,
+        .count  = 1
+    };
+    ZE_SAFE_CALL(zeEventPoolCreate(ze.context, &poolDesc, 1, &ze.device, &pool));
+    ze_event_handle_t done;
+    const ze_event_desc_t eventDesc = {
+        .stype  = ZE_STRUCTURE_TYPE_EVENT_DESC,
+        .pNext  = NULL,
+        .index  = 0,
+        .signal = ZE_EVENT_SCOPE_FLAG_HOST,
+        .wait   = ZE_EVENT_SCOPE_FLAG_HOST,
+    };
+    ZE_SAFE_CALL(zeEventCreate(pool, &eventDesc, &done));
+
+    //////////////
+    //  RUN     //
+    //////////////
+
+    std::vector<uint64_t> submit(REPETITIONS);
+    std::vector<uint64_t> total(REPETITIONS);
+    printf("%8s %8s %8s %-10s %12s %18s %12s %10s\n",
+            "sx", "sy", "tiles", "list", "record (us)", "submit/copy (ns)", "median (us)", "GB/s");
+    for (uint32_t sy : sys)
+    {
+        for (uint32_t sx : sxs)
+        {
+            const size_t size = (size_t) sx * sy * sizeof(TYPE);
+            const size_t size_all = (size_t) N_TILES * size;
+
+            host_alloc_t in, out;
+            if (!host_alloc(alloc, ze.driver, ze.context, size_all, &in) ||
+                !host_alloc(alloc, ze.driver, ze.context, size_all, &out))
+                LOGGER_FATAL("No `%s` host memory", HOST_ALLOC_NAMES[alloc]);
+            TYPE * hst_in = (TYPE *) in.ptr;
+            for (size_t i = 0 ; i < size_all / sizeof(TYPE) ; ++i)
+                hst_in[i] = i;
+
+            const ze_device_mem_alloc_desc_t deviceDesc = {
+                .stype   = ZE_STRUCTURE_TYPE_DEVICE_MEM_ALLOC_DESC,
+                .pNext   = NULL,
+                .flags   = 0,
+                .ordinal = 0,
+            };
+            char * dev_mem;
+            ZE_SAFE_CALL(zeMemAllocDevice(ze.context, &deviceDesc, size_all, 64, ze.device, (void **) &dev_mem));
+            ZE_SAFE_CALL(zeContextMakeMemoryResident(ze.context, ze.device, dev_mem, size_all));
+
+            for (int mode = 0 ; mode < LIST_MAX ; ++mode)
+            {
+                memset(out.ptr, 0, size_all);
+
+                // record once
+                uint64_t record = 0;
+                if (mode == LIST_REPLAY)
+                {
+                    const uint64_t t0 = now();
+                    ZE_SAFE_CALL(zeCommandListReset(recorded));
+                    append_round(recorded, (char *) in.ptr, (char *) out.ptr, dev_mem, sx, sy, NULL);
+                    ZE_SAFE_CALL(zeCommandListClose(recorded));
+                    record = now() - t0;
+                }
+
+                // warmup, then rounds
+                for (int r = -1 ; r < (int) REPETITIONS ; ++r)
+                {
+                    const uint64_t t0 = now();
+                    uint64_t t1;
+                    if (mode == LIST_IMMEDIATE)
+                    {
+                        append_round(engine.list, (char *) in.ptr, (char *) out.ptr, dev_mem, sx, sy, done);
+                        t1 = now();
+                        ZE_SAFE_CALL(zeEventHostSynchronize(done, UINT64_MAX));
+                        ZE_SAFE_CALL(zeEventHostReset(done));
+                    }
+                    else
+                    {
+                        ZE_SAFE_CALL(zeCommandQueueExecuteCommandLists(queue, 1, &recorded, fence));
+                        t1 = now();
+                        ZE_SAFE_CALL(zeFenceHostSynchronize(fence, UINT64_MAX));
+                        ZE_SAFE_CALL(zeFenceReset(fence));
+                    }
+                    const uint64_t t2 = now();
+                    if (r >= 0)
+                    {
+                        submit[r] = t1 - t0;
+                        total[r]  = t2 - t0;
+                    }
+                }
+                qsort(submit.data(), REPETITIONS, sizeof(uint64_t), cmp);
+                qsort(total.data(),  REPETITIONS, sizeof(uint64_t), cmp);
+
+                const uint64_t median = total[REPETITIONS / 2];
+                printf("%8u %8u %8u %-10s %12.2lf %18.1lf %12.2lf %10.2lf\n",
+                        sx, sy, N_TILES, LIST_NAMES[mode],
+                        (double) record / 1e3,
+                        (double) submit[REPETITIONS / 2] / (2.0 * N_TILES),
+                        (double) median / 1e3,
+                        2.0 * (double) size_all / (double) median);
+                fflush(stdout);
+
+                if (memcmp(in.ptr, out.ptr, size_all))
+                    LOGGER_FATAL("FAILURE: %s list, tiles of %ux%u", LIST_NAMES[mode], sx, sy);
+            }
+
+            ZE_SAFE_CALL(zeMemFree(ze.context, dev_mem));
+            host_free(&in);
+            host_free(&out);
+        }
+    }
+    LOGGER_INFO("SUCCESS");
+
+    //////////////
+    //  DEINIT  //
+    //////////////
+
+    LOGGER_INFO("Deinit");
+
+    ZE_SAFE_CALL(zeEventDestroy(done));
+    ZE_SAFE_CALL(zeEventPoolDestroy(pool));
+    ZE_SAFE_CALL(zeFenceDestroy(fence));
+    ZE_SAFE_CALL(zeCommandListDestroy(recorded));
+    ZE_SAFE_CALL(zeCommandQueueDestroy(queue));
+    ze_device_engines_release(&engine, 1);
+    ze_device_deinit(&ze);
+
+    return 0;
+}
@@ -0,0 +1,346 @@
+/**
+ *  Streaming a host array larger than the device memory through a ring of
+ *  'RING' device tiles.
+ *
+ *  The host array is made of 'N_CHUNKS' tiles of 'SY' rows of 'SX' floats.
+ *  Chunk 'k' goes to the device tile 'k % RING' (H2D, on a first engine),
+ *  then back to an output host array (D2H, on a second engine). Copies are
+ *  chained on the device timeline only:
+ *      - D2H(k) waits for H2D(k)
+ *      - H2D(k) waits for D2H(k - RING), which frees its device tile
+ *  so that H2D of chunk 'k + 1' overlaps with D2H of chunk 'k'.
+ *
+ *  Events are recycled in 'EVENTS_PER_SLOT * RING' sets: the host only
+ *  waits for a chunk far behind the ones it submits before resetting its
+ *  events, to bound the number of copies in flight, never between phases.
+ *
+ *  Reports the median throughput of the pipeline next to the ones of the
+ *  H2D and D2H directions alone through the same ring, and the ratio of
+ *  the pipeline over the slowest direction (1.0 is a perfect overlap).
+ *
+ *  usage: memcpy2d-stream [-x SX] [-y SY] [-n N_CHUNKS] [-R RING] [-a ALLOC] [-r REPS]
+ */
+
+# include <assert.h>
+# include <getopt.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+# include <ze_api.h>
+
+# include <vector>
+
+# define LOGGER_HEADER "MEMCPY2D-STREAM"
+# include "logger-ze.h"
+# include "ze-device.h"
+# include "ze-host-alloc.h"
+
+// type of the data copied
+# define TYPE float
+
+// event sets per device tile
+# define EVENTS_PER_SLOT 4
+
+typedef enum    stream_mode_e
+{
+    MODE_H2D,
+    MODE_D2H,
+    MODE_STREAM,
+    MODE_MAX
+}               stream_mode_t;
+
+static const char * MODE_NAMES[MODE_MAX] = {
+    "h2d",
+    "d2h",
+    "stream"
+};
+
+static uint32_t SX = 512;
+static uint32_t SY = 512;
+static unsigned int N_CHUNKS = 256;
+static unsigned int RING = 2;
+static unsigned int REPETITIONS = 5;
+
+// engines for each direction, may be the same
+static ze_command_list_handle_t h2d_list;
+static ze_command_list_handle_t d2h_list;
+
+// completion of the H2D/D2H of the chunks of each event set
+static std::vector<ze_event_handle_t> h2d_done;
+static std::vector<ze_event_handle_t> d2h_done;
+
+static inline uint64_t
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static int
+cmp(const void * a, const void * b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static void
+copy(
+    ze_command_list_handle_t list,
+    void * dst, const void * src,
+    size_t width, uint32_t height,
+    ze_event_handle_t signal, ze_event_handle_t wait
+) {
+    const ze_copy_region_t region = {
+        .originX = 0,
+        .originY = 0,
+        .originZ = 0,
+        .width   = (uint32_t) width,
+        .height  = height,
+        .depth   = 0
+    };
+    ZE_SAFE_CALL(
+        zeCommandListAppendMemoryCopyRegion(
+            list,
+            dst, &region, width, 0,
+            src, &region, width, 0,
+            signal,
+            wait ? 1 : 0,
+            wait ? &wait : NULL
+        )
+    );
+}
+
+// the event completing the last copy of the chunk 'k'
+static ze_event_handle_t
+last_event(stream_mode_t mode, unsigned int k)
+{
+    const unsigned int set = k % h2d_done.size();
+    return mode == MODE_H2D ? h2d_done[set] : d2h_done[set];
+}
+
+// push the 'N_CHUNKS' chunks, returns the time in ns
+static uint64_t
+stream(stream_mode_t mode, char * hst_in, char * hst_out, char ** dev_mem)
+{
+    const size_t width = SX * sizeof(TYPE);
+    const size_t size  = width * SY;
+    const unsigned int nsets = h2d_done.size();
+
+    for (unsigned int set = 0 ; set < nsets ; ++set)
+    {
+        ZE_SAFE_CALL(zeEventHostReset(h2d_done[set]));
+        ZE_SAFE_CALL(zeEventHostReset(d2h_done[set]));
+    }
+
+    uint64_t t0 = now();
+    for (unsigned int k = 0 ; k < N_CHUNKS ; ++k)
+    {
+        const unsigned int set  = k % nsets;
+        const unsigned int slot = k % RING;
+
+        // recycle the event set of the chunk 'k - nsets'
+        if (k >= nsets)
+        {
+            // once D2H(k - nsets + RING) completed, H2D(k - nsets + RING) consumed
+            // the D2H event of 'k - nsets', and D2H(k - nsets) its H2D event
+            const unsigned int done = mode == MODE_STREAM ? k - nsets + RING : k - nsets;
+            ZE_SAFE_CALL(zeEventHostSynchronize(last_event(mode, done), UINT64_MAX));
+            ZE_SAFE_CALL(zeEventHostReset(h2d_done[set]));
+            ZE_SAFE_CALL(zeEventHostReset(d2h_done[set]));
+        }
+
+        char * in  = hst_in  + (size_t) k * size;
+        char * out = hst_out + (size_t) k * size;
+        switch (mode)
+        {
+            case (MODE_H2D):
+                copy(h2d_list, dev_mem[slot], in, width, SY, h2d_done[set], NULL);
+                break ;
+
+            case (MODE_D2H):
+                copy(d2h_list, out, dev_mem[slot], width, SY, d2h_done[set], NULL);
+                break ;
+
+            case (MODE_STREAM):
+            {
+                ze_event_handle_t freed = k >= RING ? d2h_done[(k - RING) % nsets] : NULL;
+                copy(h2d_list, dev_mem[slot], in, width, SY, h2d_done[set], freed);
+                copy(d2h_list, out, dev_mem[slot], width, SY, d2h_done[set], h2d_done[set]);
+                break ;
+            }
+
+            default:
+                LOGGER_FATAL("Unknown mode");
+        }
+    }
+
+    // chunks not waited for yet
+    const unsigned int first = N_CHUNKS > nsets ? N_CHUNKS - nsets : 0;
+    for (unsigned int k = first ; k < N_CHUNKS ; ++k)
+        ZE_SAFE_CALL(zeEventHostSynchronize(last_event(mode, k), UINT64_MAX));
+
+    return now() - t0;
+}
+
+int
+main(int argc, char ** argv)
+{
+    host_alloc_kind_t alloc = HOST_ALLOC_MALLOC;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "x:y:n:R:a:r:")) != -1)
+    {
+        switch (opt)
+        {
+            case ('x'): SX = atoi(optarg); break ;
+            case ('y'): SY = atoi(optarg); break ;
+            case ('n'): N_CHUNKS = atoi(optarg); break ;
+            case ('R'): RING = atoi(optarg); break ;
+            case ('r'): REPETITIONS = atoi(optarg); break ;
+            case ('a'):
+            {
+                int a;
+                for (a = 0 ; a < HOST_ALLOC_MAX ; ++a)
+                    if (strcmp(optarg, HOST_ALLOC_NAMES[a]) == 0)
+                        break ;
+                if (a == HOST_ALLOC_MAX)
+                    LOGGER_FATAL("Unknown host allocator `%s`", optarg);
+                alloc = (host_alloc_kind_t) a;
+                break ;
+            }
+            default:
+                fprintf(stderr, "usage: %s [-x SX] [-y SY] [-n N_CHUNKS] [-R RING] [-a ALLOC] [-r REPS]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (RING == 0)
+        RING = 1;
+    if (REPETITIONS == 0)
+        REPETITIONS = 1;
+
+    //////////////
+    //  INIT    //
+    //////////////
+
+    LOGGER_INFO("Init");
+
+    ze_device_t ze;
+    ze_device_init(&ze);
+
+    // one engine per direction, if the device has two
+    ze_engine_t engines[2];
+    const unsigned int nengines = ze_device_engines(&ze, ZE_ENGINES_ALL, engines, 2);
+    if (nengines == 0)
+        LOGGER_FATAL("No copy engine");
+    if (nengines == 1)
+        LOGGER_WARN("A single copy engine: H2D and D2H cannot overlap");
+    h2d_list = engines[0].list;
+    d2h_list = engines[nengines - 1].list;
+    LOGGER_INFO("H2D on engine (%u, %u), D2H on engine (%u, %u)",
+            engines[0].ordinal, engines[0].index, engines[nengines - 1].ordinal, engines[nengines - 1].index);
+
+    // events
+    const unsigned int nsets = EVENTS_PER_SLOT * RING;
+    ze_event_pool_handle_t pool;
+    const ze_event_pool_desc_t poolDesc = {
+        .stype  = ZE_STRUCTURE_TYPE_EVENT_POOL_DESC,
+        .pNext  = NULL,
+        .flags  = ZE_EVENT_POOL_FLAG_HOST_VISIBLE,
+        .count  = 2 * nsets
+    };
+    ZE_SAFE_CALL(zeEventPoolCreate(ze.context, &poolDesc, 1, &ze.device, &pool));
+    h2d_done.resize(nsets);
+    d2h_done.resize(nsets);
+    for (unsigned int i = 0 ; i < 2 * nsets ; ++i)
+    {
+        ze_event_desc_t eventDesc = {
+            .stype  = ZE_STRUCTURE_TYPE_EVENT_DESC,
+            .pNext  = NULL,
+            .index  = i,
+            .signal = ZE_EVENT_SCOPE_FLAG_HOST,
+            .wait   = ZE_EVENT_SCOPE_FLAG_HOST,
+        };
+        ZE_SAFE_CALL(zeEventCreate(pool, &eventDesc, i < nsets ? &h2d_done[i] : &d2h_done[i - nsets]));
+    }
+
+    // host arrays
+    const size_t size = (size_t) SX * SY * sizeof(TYPE);
+    const size_t size_all = (size_t) N_CHUNKS * size;
+    host_alloc_t in, out;
+    if (!host_alloc(alloc, ze.driver, ze.context, size_all, &in) ||
+        !host_alloc(alloc, ze.driver, ze.context, size_all, &out))
+        LOGGER_FATAL("No `%s` host memory", HOST_ALLOC_NAMES[alloc]);
+    TYPE * hst_in = (TYPE *) in.ptr;
+    for (size_t i = 0 ; i < size_all / sizeof(TYPE) ; ++i)
+        hst_in[i] = i;
+    memset(out.ptr, 0, size_all);
+
+    // device ring
+    const ze_device_mem_alloc_desc_t deviceDesc = {
+        .stype   = ZE_STRUCTURE_TYPE_DEVICE_MEM_ALLOC_DESC,
+        .pNext   = NULL,
+        .flags   = 0,
+        .ordinal = 0,
+    };
+    std::vector<char *> dev_mem(RING);
+    for (unsigned int i = 0 ; i < RING ; ++i)
+    {
+        ZE_SAFE_CALL(zeMemAllocDevice(ze.context, &deviceDesc, size, 64, ze.device, (void **) &dev_mem[i]));
+        ZE_SAFE_CALL(zeContextMakeMemoryResident(ze.context, ze.device, dev_mem[i], size));
+    }
+
+    //////////////
+    //  RUN     //
+    //////////////
+
+    LOGGER_INFO("Streaming %u chunks of %zu bytes (%.2lf GB) through %u device tiles",
+            N_CHUNKS, size, (double) size_all / 1e9, RING);
+
+    double gbs[MODE_MAX];
+    std::vector<uint64_t> ns(REPETITIONS);
+    printf("%8s %8s %8s %6s %-8s %12s %10s\n", "sx", "sy", "chunks", "ring", "mode", "median (us)", "GB/s");
+    for (int mode = 0 ; mode < MODE_MAX ; ++mode)
+    {
+        // warmup
+        stream((stream_mode_t) mode, (char *) in.ptr, (char *) out.ptr, dev_mem.data());
+        for (unsigned int r = 0 ; r < REPETITIONS ; ++r)
+            ns[r] = stream((stream_mode_t) mode, (char *) in.ptr, (char *) out.ptr, dev_mem.data());
+        qsort(ns.data(), REPETITIONS, sizeof(uint64_t), cmp);
+
+        const uint64_t median = ns[REPETITIONS / 2];
+        gbs[mode] = (double) size_all / (double) median;
+        printf("%8u %8u %8u %6u %-8s %12.2lf %10.2lf\n", SX, SY, N_CHUNKS, RING, MODE_NAMES[mode], (double) median / 1e3, gbs[mode]);
+        fflush(stdout);
+    }
+
+    const double peak = gbs[MODE_H2D] < gbs[MODE_D2H] ? gbs[MODE_H2D] : gbs[MODE_D2H];
+    printf("stream / min(h2d, d2h) = %.2lf\n", gbs[MODE_STREAM] / peak);
+
+    // the last stream went through the device
+    if (memcmp(in.ptr, out.ptr, size_all))
+        LOGGER_FATAL("FAILURE");
+    LOGGER_INFO("SUCCESS");
+
+    //////////////
+    //  DEINIT  //
+    //////////////
+
+    LOGGER_INFO("Deinit");
+
+    for (unsigned int i = 0 ; i < RING ; ++i)
+        ZE_SAFE_CALL(zeMemFree(ze.context, dev_mem[i]));
+    host_free(&in);
+    host_free(&out);
+    for (unsigned int set = 0 ; set < nsets ; ++set)
+    {
+        ZE_SAFE_CALL(zeEventDestroy(h2d_done[set]));
+        ZE_SAFE_CALL(zeEventDestroy(d2h_done[set]));
+    }
+    ZE_SAFE_CALL(zeEventPoolDestroy(pool));
+    ze_device_engines_release(engines, nengines);
+    ze_device_deinit(&ze);
+
+    return 0;
+}
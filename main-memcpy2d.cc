@@ -25,46 +25,346 @@
  *      - set host memory to '0'
  *      - copies device tile 'i' to host tile 'i'
  *      - check that host memory bytes[v] == v
+ *
+ *  For every configuration of the sweep (the cartesian product of the lists
+ *  given in options), H2D and D2H are repeated 'WARMUP' times untimed, then
+ *  'REPETITIONS' times. Reports, per direction, the min/median/p99 time of
+ *  all tiles copies (from the first append to the completion of the last
+ *  copy) and the bandwidth at the median time.
+ *
+ *  usage: memcpy2d [OPTIONS] [NUMBER_OF_TILES]
+ *      -x, --sx LIST       tile widths, in elements                (512)
+ *      -y, --sy LIST       tile heights, in elements               (512)
+ *      -t, --type LIST     element types: char, short, float, double (float)
+ *      -n, --tiles LIST    number of tiles                         (4)
+ *      -p, --pad LIST      host row pitch padding, in bytes        (0)
+ *      -o, --offset LIST   'origin' to offset the copy region origin-x,
+ *                          'pointer' to offset the host pointer    (origin)
+ *      -S, --strategy LIST how copies are appended: 'region', 'pointer',
+ *                          'rows', 'chunks' or 'auto' (tuned, see
+ *                          ze-copy-tuner.h)                        (region)
+ *      -w, --warmup N      untimed repetitions                     (1)
+ *      -r, --reps N        timed repetitions                       (10)
+ *      -c, --completion LIST  how the host waits for the copies   (poll)
+ *      -s, --spin N        queries before blocking in 'spin'       (4096)
+ *      -e, --engines LIST  number of engines the tiles are spread on (1)
+ *      -g, --groups GROUPS engines used: 'copy' (copy-only queue groups),
+ *                          'compute' or 'all' (copy-only first)    (copy)
+ *      -d, --dist LIST     tiles to engines: 'rr' round-robin, or 'size'
+ *                          to the engine with the least bytes      (rr)
+ *      -a, --alloc LIST    host memory: malloc, usm, import, thp,
+ *                          huge2m, huge1g, shared (see ze-host-alloc.h) (malloc)
+ *      -u, --usm LIST      with 'shared' host memory: 'migrate' (on
+ *                          demand), 'prefetch', 'advise' or 'direct'
+ *                          (no copy, tiles used in place)          (migrate)
+ *      -m, --devmem KIND   device memory: 'tile' (one allocation per
+ *                          tile), 'pool' or 'vm' (tiles carved out of
+ *                          slabs, see ze-device-pool.h)            (pool)
+ *      -N, --numa LIST     host memory node: 'none' (first touch),
+ *                          'local' or 'remote' to the device       (none)
+ *      -k, --check KIND    verification of the data copied back:
+ *                          'pattern' (compare with the values written),
+ *                          'crc32c' (compare per-tile checksums) or
+ *                          'none'                                  (pattern)
+ *      -f, --format FMT    'text', 'csv' or 'json'                 (text)
+ *
+ *  e.g: memcpy2d -x 64,512,4096 -y 512 -t float,double -n 1,4,16 -p 0,64 -o origin,pointer -f csv
+ *
+ *  Completion strategies, all returning once every copy completed:
+ *      - poll      query every event, 'sched_yield' while not ready
+ *      - hostsync  'zeEventHostSynchronize' on each event
+ *      - spin      query events for a bounded number of queries, then
+ *                  'zeEventHostSynchronize' on the remaining ones
+ *      - tail      append a barrier signaling a single event after the
+ *                  copies, and only synchronize on it
+ *      - callback  query the pending events only, and call 'completed(i)'
+ *                  as soon as the copy 'i' completed, in completion order
+ *  with, for each, the time spent waiting after the last append (the
+ *  completion latency) and the process cpu time spent meanwhile.
+ *
+ *  Command queue groups are listed at init: one immediate command list is
+ *  created on each engine (queue index) of the selected groups, and tiles
+ *  of a configuration are spread on its first 'ENGINES' engines.
+ *
+ *  The host allocation (and registration) time is reported apart, as
+ *  'alloc (us)': pinning pays off for buffers reused by many transfers.
+ *  Configurations whose host memory kind is not available are skipped.
+ *
+ *  Device tiles come from a pool living for the whole sweep: tiles released
+ *  at the end of a configuration are reused by the next ones of the same
+ *  size, without allocating nor making resident device memory again.
+ *  Events are recycled the same way (see ze-event-pool.h), so that the
+ *  number of tiles is not bounded.
+ *
+ *  With a 'local' or 'remote' placement, the submitting thread is bound to
+ *  the node of the device (from its PCI address, see ze-numa.h) before host
+ *  memory is allocated, and host memory is bound to that node or to another
+ *  one before being written. Host memory the driver pins or migrates
+ *  ('usm', 'import', 'shared') cannot be bound, and is only swept with the
+ *  'none' placement. When both are swept, the local over remote bandwidth
+ *  ratio is reported.
+ *
+ *  With 'shared' host memory, tiles live in a 'zeMemAllocShared' buffer
+ *  migrated between the host and the device:
+ *      - migrate   on demand, when the copy engine or the host touches it
+ *      - prefetch  'zeCommandListAppendMemoryPrefetch' of the rows of each
+ *                  tile before its copy
+ *      - advise    the buffer is advised 'PREFERRED_LOCATION' the device
+ *                  once allocated, then migrated on demand
+ *      - direct    no copy: the device tiles are the host tiles of the
+ *                  shared buffer. 'h2d' prefetches the rows of each tile
+ *                  to the device, and 'd2h' is the host reading every page
+ *                  of each tile back. The buffer, only written by the fill,
+ *                  is advised 'READ_MOSTLY', so that the host reads it
+ *                  back from a copy instead of migrating it again.
+ *  The 'direct' rows are timed as the explicit copies, for comparison; no
+ *  strategy applies to them. They are not checked: nothing copies the data
+ *  back, so that host memory is not cleared before the last 'd2h' and
+ *  still holds the fill (padding included). The copy modes do not advise
+ *  'READ_MOSTLY': the D2H copies rewrite the buffer every repetition.
+ *  After each D2H, the host reads every page of each tile in turn, which
+ *  brings the pages back to the host before the next H2D. The median per
+ *  tile time of this first touch is reported as 'touch (us)' (D2H only),
+ *  for every kind of host memory so that explicit buffers give the
+ *  baseline.
+ *
+ *  Tiles are copied through 'copy_tuner_copy' (see ze-copy-tuner.h): with
+ *  the 'auto' strategy, the first copy of each shape and direction tunes
+ *  the strategy, and the result is cached on disk for the device and its
+ *  driver version, so that later runs reuse it without tuning.
+ *
+ *  Host memory is written, cleared and verified by OpenMP threads with
+ *  vectorized kernels (see memcpy2d-check.h). A failing check logs the
+ *  first differing byte of each failing tile.
+ *
+ *  No GPU is needed to check the strategies: the Level Zero loader null
+ *  driver completes every command immediately (`ZE_ENABLE_NULL_DRIVER=1`).
+ *  Copies are then not performed, so that verification defaults to 'none'
+ *  with it (an explicit '-k' still applies, and fails).
  */
 
 # include <assert.h>
+# include <getopt.h>
 # include <sched.h>
 # include <stdlib.h>
 # include <string.h>
+# include <time.h>
 # include <ze_api.h>
-# include "logger-ze.h"
-
-// If '1', then uses region offset-x in the copy
-// else if '0', then manually offset the pointer
-# define USING_OFFSET 1
 
-// 2d region size
-# define REGION_SX 512
-# define REGION_SY 512
+# include <vector>
 
-// type of the data copied
-# define TYPE float
-
-// maximum number of tiles
-# define N_TILES_MAX 64
+# define LOGGER_HEADER "MEMCPY2D"
+# include "logger-ze.h"
+# include "mem.h"
+# include "memcpy2d-check.h"
+# include "ze-copy-tuner.h"
+# include "ze-device.h"
+# include "ze-device-pool.h"
+# include "ze-event-pool.h"
+# include "ze-numa.h"
+# include "ze-host-alloc.h"
 
 // number of tiles
 static unsigned int N_TILES;
 
+// events of the whole sweep, events of a configuration are recycled by the next ones
+static event_allocator_t EVENTS;
+
 // ze events for each tiles
-static ze_event_handle_t events[N_TILES_MAX];
+static std::vector<event_t *> events;
+
+// maximum number of engines
+# define N_ENGINES_MAX 64
+
+// engine on which each tile is copied
+static std::vector<unsigned int> engine_of;
+
+// ze events signaled once all tiles of an engine are copied, for the 'tail' completion
+static event_t * tails[N_ENGINES_MAX];
+
+// tiles in completion order, for the 'callback' completion
+static std::vector<unsigned int> completions;
+static unsigned int ncompletions;
+
+// engines the tiles are spread on
+static ze_engine_t ENGINES[N_ENGINES_MAX];
+static unsigned int N_ENGINES;
+
+// device memory of the tiles, for the whole sweep
+static device_pool_t DEVICE_POOL;
+
+// strategies of the tile copies
+static copy_tuner_t TUNER;
+
+// size of the slabs and alignment of the tiles of the device pool
+# define DEVICE_POOL_SLAB       (256 * 1024 * 1024)
+# define DEVICE_POOL_ALIGNMENT  (64 * 1024)
+
+// the device
+static ze_device_handle_t DEVICE;
+
+// node of the device, and initial affinity of the submitting thread
+static int DEVICE_NODE;
+static cpu_set_t AFFINITY;
+
+// element type of the data copied
+typedef struct  type_s
+{
+    const char * name;
+    size_t size;
+    void (*fill)(void * mem, size_t n);
+    ssize_t (*verify)(const void * mem, size_t offset, size_t n);
+}               type_t;
+
+static const type_t TYPES[] = {
+    { "char",   sizeof(char),   memcpy2d_fill<char>,   memcpy2d_verify<char>   },
+    { "short",  sizeof(short),  memcpy2d_fill<short>,  memcpy2d_verify<short>  },
+    { "float",  sizeof(float),  memcpy2d_fill<float>,  memcpy2d_verify<float>  },
+    { "double", sizeof(double), memcpy2d_fill<double>, memcpy2d_verify<double> }
+};
+
+// how the copied data is verified
+typedef enum    check_e
+{
+    CHECK_PATTERN,
+    CHECK_CRC32C,
+    CHECK_NONE,
+    CHECK_MAX
+}               check_t;
+
+static const char * CHECK_NAMES[CHECK_MAX] = {
+    "pattern",
+    "crc32c",
+    "none"
+};
+
+// maximum number of failing tiles logged
+# define CHECK_MAX_REPORTED 8
+
+typedef enum    distribution_e
+{
+    DISTRIBUTION_RR,
+    DISTRIBUTION_SIZE,
+    DISTRIBUTION_MAX
+}               distribution_t;
+
+static const char * DISTRIBUTION_NAMES[DISTRIBUTION_MAX] = {
+    "rr",
+    "size"
+};
+
+typedef enum    completion_e
+{
+    COMPLETION_POLL,
+    COMPLETION_HOSTSYNC,
+    COMPLETION_SPIN,
+    COMPLETION_TAIL,
+    COMPLETION_CALLBACK,
+    COMPLETION_MAX
+}               completion_t;
+
+static const char * COMPLETION_NAMES[COMPLETION_MAX] = {
+    "poll",
+    "hostsync",
+    "spin",
+    "tail",
+    "callback"
+};
+
+// migration hints of 'shared' host memory
+typedef enum    usm_e
+{
+    USM_MIGRATE,
+    USM_PREFETCH,
+    USM_ADVISE,
+    USM_DIRECT,
+    USM_MAX
+}               usm_t;
+
+static const char * USM_NAMES[USM_MAX] = {
+    "migrate",
+    "prefetch",
+    "advise",
+    "direct"
+};
+
+// a configuration of the sweep
+typedef struct  config_s
+{
+    uint32_t sx, sy;
+    const type_t * type;
+    unsigned int ntiles;
+    uint32_t pad;
+    int using_offset;
+    copy_strategy_t strategy;
+    completion_t completion;
+    unsigned int nengines;
+    distribution_t distribution;
+    host_alloc_kind_t alloc;
+    usm_t usm;
+    numa_placement_t numa;
+}               config_t;
+
+// bandwidth of each direction of a configuration, '0' if skipped
+typedef struct  gbs_s
+{
+    double h2d;
+    double d2h;
+}               gbs_t;
+
+// times of one direction, in ns
+typedef struct  timing_s
+{
+    uint64_t total;     // from the first append to the completion
+    uint64_t wait;      // from the last append to the completion
+    uint64_t cpu;       // process cpu time while waiting
+    uint64_t touch;     // median host first touch of a tile, after D2H
+}               timing_t;
+
+typedef enum    format_e
+{
+    FORMAT_TEXT,
+    FORMAT_CSV,
+    FORMAT_JSON
+}               format_t;
+
+static unsigned int WARMUP = 1;
+static unsigned int REPETITIONS = 10;
+static unsigned int SPIN = 4096;
+static format_t FORMAT = FORMAT_TEXT;
+static check_t CHECK = CHECK_PATTERN;
+
+// number of results printed so far
+static unsigned int NRESULTS = 0;
+
+static inline uint64_t
+now_clock(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static inline uint64_t
+now(void)
+{
+    return now_clock(CLOCK_MONOTONIC);
+}
 
-// ze command list
-static ze_command_list_handle_t list;
+static int
+cmp(const void * a, const void * b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
 
 // wait for each tile
 static void
-wait(void)
+wait_poll(void)
 {
     // if the i-th copy is done
-    bool done[N_TILES_MAX];
-    for (unsigned int i = 0 ; i < N_TILES ; ++i)
-        done[i] = false;
+    std::vector<bool> done(N_TILES, false);
 
     unsigned int ndone = 0;
     while (ndone != N_TILES)
@@ -78,7 +378,7 @@ wait(void)
                 continue ;
             }
 
-            ze_event_handle_t event = events[i];
+            ze_event_handle_t event = events[i]->event;
             ze_result_t res;
             for (unsigned int j = 0 ; j < 16 ; ++j)
             {
@@ -97,253 +397,870 @@ wait(void)
     }
 }
 
+// block on each tile
+static void
+wait_hostsync(void)
+{
+    for (unsigned int i = 0 ; i < N_TILES ; ++i)
+        ZE_SAFE_CALL(zeEventHostSynchronize(events[i]->event, UINT64_MAX));
+}
+
+// spin on the tiles for 'SPIN' queries, then block on the remaining ones
+static void
+wait_spin(void)
+{
+    unsigned int budget = SPIN;
+    for (unsigned int i = 0 ; i < N_TILES ; ++i)
+    {
+        ze_result_t res;
+        while (budget && (res = zeEventQueryStatus(events[i]->event)) == ZE_RESULT_NOT_READY)
+        {
+            --budget;
+            mem_pause();
+        }
+        if (budget == 0)
+            ZE_SAFE_CALL(zeEventHostSynchronize(events[i]->event, UINT64_MAX));
+        else if (res != ZE_RESULT_SUCCESS)
+            ZE_SAFE_CALL(res);
+    }
+}
+
+// a single event per engine, signaled once all previous copies completed
+static void
+wait_tail(unsigned int nengines)
+{
+    for (unsigned int e = 0 ; e < nengines ; ++e)
+    {
+        ZE_SAFE_CALL(zeEventHostReset(tails[e]->event));
+        ZE_SAFE_CALL(zeCommandListAppendBarrier(ENGINES[e].list, tails[e]->event, 0, NULL));
+    }
+    for (unsigned int e = 0 ; e < nengines ; ++e)
+        ZE_SAFE_CALL(zeEventHostSynchronize(tails[e]->event, UINT64_MAX));
+}
+
+// the copy 'i' completed
+static void
+completed(unsigned int i)
+{
+    completions[ncompletions++] = i;
+}
+
+// query pending tiles only, and process them in completion order
+static void
+wait_callback(void)
+{
+    std::vector<unsigned int> pending(N_TILES);
+    unsigned int npending = N_TILES;
+    for (unsigned int i = 0 ; i < N_TILES ; ++i)
+        pending[i] = i;
+
+    ncompletions = 0;
+    while (npending)
+    {
+        unsigned int j = 0;
+        for (unsigned int k = 0 ; k < npending ; ++k)
+        {
+            const unsigned int i = pending[k];
+            ze_result_t res = zeEventQueryStatus(events[i]->event);
+            if (res == ZE_RESULT_SUCCESS)
+                completed(i);
+            else if (res == ZE_RESULT_NOT_READY)
+                pending[j++] = i;
+            else
+                ZE_SAFE_CALL(res);
+        }
+        if (j == npending)
+            sched_yield();
+        npending = j;
+    }
+}
+
+// wait for all tiles, returns the wait and cpu times
+static void
+wait(const config_t & c, timing_t & timing)
+{
+    const uint64_t c0 = now_clock(CLOCK_PROCESS_CPUTIME_ID);
+    const uint64_t t0 = now();
+    switch (c.completion)
+    {
+        case (COMPLETION_POLL):     wait_poll();        break ;
+        case (COMPLETION_HOSTSYNC): wait_hostsync();    break ;
+        case (COMPLETION_SPIN):     wait_spin();        break ;
+        case (COMPLETION_TAIL):     wait_tail(c.nengines); break ;
+        case (COMPLETION_CALLBACK): wait_callback();    break ;
+        default:                    LOGGER_FATAL("Unknown completion");
+    }
+    timing.wait = now() - t0;
+    timing.cpu  = now_clock(CLOCK_PROCESS_CPUTIME_ID) - c0;
+}
+
 static void
 copy(
+    const config_t & c, copy_direction_t direction,
     unsigned int i,
     void * dst, const void * src,
     const size_t dst_pitch, const size_t src_pitch,
     uint32_t width, uint32_t height,
     uint32_t dst_ox, uint32_t src_ox
 ) {
-    ze_event_handle_t event = events[i];
+    ze_event_handle_t event = events[i]->event;
     ZE_SAFE_CALL(zeEventHostReset(event));
 
-    const uint32_t num_wait_events = 0;
-    ze_event_handle_t * wait_events = NULL;
+    copy_tuner_copy(&TUNER, c.strategy, engine_of[i], direction,
+            dst, src, dst_pitch, src_pitch, width, height, dst_ox, src_ox, event);
+}
 
-    const uint32_t dst_slice_pitch = 0;
-    const uint32_t src_slice_pitch = 0;
+/**
+ *  Prefetch the host tile 'i' to the device, with 'shared' memory and the
+ *  'prefetch' or 'direct' hints, row by row: its rows are interleaved with
+ *  the rows of the other tiles, which a single range would prefetch too.
+ */
+static void
+prefetch(const config_t & c, unsigned int i, const char * hst_mem, size_t pitch)
+{
+    if (c.alloc != HOST_ALLOC_SHARED || (c.usm != USM_PREFETCH && c.usm != USM_DIRECT))
+        return ;
+    const size_t width = c.sx * c.type->size;
+    for (uint32_t y = 0 ; y < c.sy ; ++y)
+        ZE_SAFE_CALL(zeCommandListAppendMemoryPrefetch(ENGINES[engine_of[i]].list,
+                    hst_mem + y * pitch + i * width, width));
+}
 
-    const ze_copy_region_t dst_region = {
-        .originX = dst_ox,
-        .originY = 0,
-        .originZ = 0,
-        .width   = (uint32_t) width,
-        .height  = (uint32_t) height,
-        .depth   = 0
-    };
+// copy every host tile to its device tile
+static timing_t
+h2d(const config_t & c, char * hst_mem, char ** dev_mem)
+{
+    timing_t timing;
+    const size_t width = c.sx * c.type->size;
+    uint64_t t0 = now();
+    for (unsigned int i = 0 ; i < N_TILES ; ++i)
+    {
+        const size_t dst_pitch = width;
+        const size_t src_pitch = N_TILES * width + c.pad;
+        prefetch(c, i, hst_mem, src_pitch);
 
-    const ze_copy_region_t src_region = {
-        .originX = src_ox,
-        .originY = 0,
-        .originZ = 0,
-        .width   = (uint32_t) width,
-        .height  = (uint32_t) height,
-        .depth   = 0
-    };
+        // no copy, the tile is on the device once prefetched
+        if (c.usm == USM_DIRECT)
+        {
+            ZE_SAFE_CALL(zeEventHostReset(events[i]->event));
+            ZE_SAFE_CALL(zeCommandListAppendBarrier(ENGINES[engine_of[i]].list, events[i]->event, 0, NULL));
+            continue ;
+        }
 
-    ZE_SAFE_CALL(
-        zeCommandListAppendMemoryCopyRegion(
-            list,
-            dst,
-           &dst_region,
-            dst_pitch,
-            dst_slice_pitch,
-            src,
-           &src_region,
-            src_pitch,
-            src_slice_pitch,
-            event,
-            num_wait_events,
-            wait_events
-        )
-    );
+        if (c.using_offset)
+            copy(c, COPY_H2D, i, dev_mem[i], hst_mem,             dst_pitch, src_pitch, width, c.sy, 0, i * width);
+        else
+            copy(c, COPY_H2D, i, dev_mem[i], hst_mem + i * width, dst_pitch, src_pitch, width, c.sy, 0, 0);
+    }
+    wait(c, timing);
+    timing.total = now() - t0;
+    timing.touch = 0;
+    copy_tuner_release(&TUNER);
+    return timing;
 }
 
-int
-main(int argc, char ** argv)
+// copy every device tile to its host tile
+static timing_t
+d2h(const config_t & c, char * hst_mem, char ** dev_mem)
 {
-    if (argc != 2)
+    timing_t timing;
+    const size_t width = c.sx * c.type->size;
+    uint64_t t0 = now();
+    for (unsigned int i = 0 ; i < N_TILES ; ++i)
     {
-        fprintf(stderr, "usage: %s [NUMBER_OF_TILES]\n", argv[0]);
-        return 1;
+        const size_t dst_pitch = N_TILES * width + c.pad;
+        const size_t src_pitch = width;
+        prefetch(c, i, hst_mem, dst_pitch);
+
+        if (c.using_offset)
+            copy(c, COPY_D2H, i, hst_mem,             dev_mem[i], dst_pitch, src_pitch, width, c.sy, i * width, 0);
+        else
+            copy(c, COPY_D2H, i, hst_mem + i * width, dev_mem[i], dst_pitch, src_pitch, width, c.sy, 0, 0);
     }
+    wait(c, timing);
+    timing.total = now() - t0;
+    timing.touch = 0;
+    copy_tuner_release(&TUNER);
+    return timing;
+}
 
-    N_TILES = atoi(argv[1]);
-    if (N_TILES > N_TILES_MAX)
-        N_TILES = N_TILES_MAX;
+/**
+ *  Read every page of each host tile in turn, and return the median time
+ *  per tile: the first touch of the tiles the device wrote, that brings
+ *  'shared' memory back to the host. Pages shared by several tiles are
+ *  paid by the first tile touching them.
+ */
+static uint64_t
+touch(const config_t & c, const char * hst_mem)
+{
+    const size_t width = c.sx * c.type->size;
+    const size_t pitch = N_TILES * width + c.pad;
+    const size_t page  = sysconf(_SC_PAGESIZE);
+    std::vector<uint64_t> ns(N_TILES);
+    volatile char sink = 0;
+    for (unsigned int i = 0 ; i < N_TILES ; ++i)
+    {
+        const uint64_t t0 = now();
+        for (uint32_t y = 0 ; y < c.sy ; ++y)
+        {
+            const char * row = hst_mem + y * pitch + i * width;
+            for (size_t b = 0 ; b < width ; b += page)
+                sink = sink + row[b];
+            sink = sink + row[width - 1];
+        }
+        ns[i] = now() - t0;
+    }
+    qsort(ns.data(), N_TILES, sizeof(uint64_t), cmp);
+    return ns[N_TILES / 2];
+}
 
-    LOGGER_INFO("Configured with `%d` tiles", N_TILES);
+// with the 'direct' hint, the host reads the tiles back from the shared buffer
+static timing_t
+d2h_direct(const config_t & c, const char * hst_mem)
+{
+    timing_t timing;
+    const uint64_t c0 = now_clock(CLOCK_PROCESS_CPUTIME_ID);
+    const uint64_t t0 = now();
+    timing.touch = touch(c, hst_mem);
+    timing.total = now() - t0;
+    timing.wait  = timing.total;
+    timing.cpu   = now_clock(CLOCK_PROCESS_CPUTIME_ID) - c0;
+    return timing;
+}
 
-    ze_init_flag_t initFlags = ZE_INIT_FLAG_GPU_ONLY;
-    ZE_SAFE_CALL(zeInit(initFlags));
+// median of the field 'F' of the 'REPETITIONS' timings, sorted in place
+static uint64_t
+median(timing_t * timings, uint64_t timing_t::* field, std::vector<uint64_t> & ns)
+{
+    for (unsigned int r = 0 ; r < REPETITIONS ; ++r)
+        ns[r] = timings[r].*field;
+    qsort(ns.data(), REPETITIONS, sizeof(uint64_t), cmp);
+    return ns[REPETITIONS / 2];
+}
 
-    //////////////
-    //  INIT    //
-    //////////////
+// assign each tile of 'size' bytes to an engine
+static void
+distribute(const config_t & c, size_t size)
+{
+    size_t load[N_ENGINES_MAX];
+    for (unsigned int e = 0 ; e < c.nengines ; ++e)
+        load[e] = 0;
 
-    LOGGER_INFO("Init");
+    for (unsigned int i = 0 ; i < N_TILES ; ++i)
+    {
+        unsigned int engine = 0;
+        switch (c.distribution)
+        {
+            case (DISTRIBUTION_RR):
+                engine = i % c.nengines;
+                break ;
+
+            case (DISTRIBUTION_SIZE):
+                for (unsigned int e = 1 ; e < c.nengines ; ++e)
+                    if (load[e] < load[engine])
+                        engine = e;
+                break ;
+
+            default:
+                LOGGER_FATAL("Unknown distribution");
+        }
+        engine_of[i] = engine;
+        load[engine] += size;
+    }
+}
 
-    // driver
-    ze_driver_handle_t driver;
-    uint32_t driverCount = 1;
-    ZE_SAFE_CALL(zeDriverGet(&driverCount, &driver));
+// print the statistics of the 'REPETITIONS' timings of a direction, returns the GB/s
+static double
+report(const config_t & c, const char * direction, timing_t * timings, uint64_t alloc_ns)
+{
+    std::vector<uint64_t> ns(REPETITIONS);
+    const double wait   = (double) median(timings, &timing_t::wait, ns) / 1e3;
+    const double cpu    = (double) median(timings, &timing_t::cpu,  ns) / 1e3;
+    const double median_total = (double) median(timings, &timing_t::total, ns) / 1e3;
+    const double min    = (double) ns[0] / 1e3;
+    const double p99    = (double) ns[(REPETITIONS * 99) / 100] / 1e3;
+    const double bytes  = (double) c.ntiles * c.sx * c.sy * c.type->size;
+    const double gbs    = bytes / (median_total * 1e3);
+    const char * offset = c.using_offset ? "origin" : "pointer";
+    const char * strategy = c.usm == USM_DIRECT ? "-" : COPY_STRATEGY_NAMES[c.strategy];
+    const char * completion = COMPLETION_NAMES[c.completion];
+    const char * distribution = DISTRIBUTION_NAMES[c.distribution];
+    const char * alloc  = HOST_ALLOC_NAMES[c.alloc];
+    const double alloc_us = (double) alloc_ns / 1e3;
+    const char * numa   = NUMA_PLACEMENT_NAMES[c.numa];
+    const char * usm    = c.alloc == HOST_ALLOC_SHARED ? USM_NAMES[c.usm] : "-";
+    const double touch  = (double) median(timings, &timing_t::touch, ns) / 1e3;
+
+    switch (FORMAT)
+    {
+        case (FORMAT_TEXT):
+            if (NRESULTS == 0)
+                printf("%6s %6s %-6s %6s %6s %-8s %-8s %-10s %7s %-4s %-6s %-8s %12s %-6s %-4s %12s %12s %12s %10s %12s %12s %12s\n",
+                        "sx", "sy", "type", "tiles", "pad", "offset", "strategy", "completion", "engines", "dist", "alloc", "usm", "alloc (us)", "numa", "dir",
+                        "min (us)", "median (us)", "p99 (us)", "GB/s", "wait (us)", "cpu (us)", "touch (us)");
+            printf("%6u %6u %-6s %6u %6u %-8s %-8s %-10s %7u %-4s %-6s %-8s %12.2lf %-6s %-4s %12.2lf %12.2lf %12.2lf %10.2lf %12.2lf %12.2lf %12.2lf\n",
+                    c.sx, c.sy, c.type->name, c.ntiles, c.pad, offset, strategy, completion, c.nengines, distribution, alloc, usm, alloc_us, numa, direction,
+                    min, median_total, p99, gbs, wait, cpu, touch);
+            break ;
+
+        case (FORMAT_CSV):
+            if (NRESULTS == 0)
+                printf("sx,sy,type,tiles,pad,offset,strategy,completion,engines,dist,alloc,usm,alloc_us,numa,dir,reps,min_us,median_us,p99_us,gbs,wait_us,cpu_us,touch_us\n");
+            printf("%u,%u,%s,%u,%u,%s,%s,%s,%u,%s,%s,%s,%.3lf,%s,%s,%u,%.3lf,%.3lf,%.3lf,%.3lf,%.3lf,%.3lf,%.3lf\n",
+                    c.sx, c.sy, c.type->name, c.ntiles, c.pad, offset, strategy, completion, c.nengines, distribution, alloc, usm, alloc_us, numa, direction,
+                    REPETITIONS, min, median_total, p99, gbs, wait, cpu, touch);
+            break ;
+
+        case (FORMAT_JSON):
+            printf("%s  {\"sx\": %u, \"sy\": %u, \"type\": \"%s\", \"tiles\": %u, \"pad\": %u, \"offset\": \"%s\", \"strategy\": \"%s\", "
+                    "\"completion\": \"%s\", \"engines\": %u, \"dist\": \"%s\", \"alloc\": \"%s\", \"usm\": \"%s\", "
+                    "\"alloc_us\": %.3lf, \"numa\": \"%s\", \"dir\": \"%s\", \"reps\": %u, \"min_us\": %.3lf, \"median_us\": %.3lf, "
+                    "\"p99_us\": %.3lf, \"gbs\": %.3lf, \"wait_us\": %.3lf, \"cpu_us\": %.3lf, \"touch_us\": %.3lf}",
+                    NRESULTS == 0 ? "[\n" : ",\n",
+                    c.sx, c.sy, c.type->name, c.ntiles, c.pad, offset, strategy, completion, c.nengines, distribution, alloc, usm, alloc_us, numa, direction,
+                    REPETITIONS, min, median_total, p99, gbs, wait, cpu, touch);
+            break ;
+    }
+    fflush(stdout);
+    ++NRESULTS;
 
-    // device
-    ze_device_handle_t device;
-    uint32_t deviceCount = 1;
-    ZE_SAFE_CALL(zeDeviceGet(driver, &deviceCount, &device));
+    return gbs;
+}
 
-    // context
-    ze_context_handle_t context;
-    ze_context_desc_t contextDesc = {
-        .stype = ZE_STRUCTURE_TYPE_CONTEXT_DESC,
-        .pNext = NULL,
-        .flags = ZE_CONTEXT_FLAG_TBD
-    };
-    ZE_SAFE_CALL(zeContextCreate(driver, &contextDesc, &context));
-
-    // stream
-    const int ordinal = 1;
-    const int   index = 0;
-    const ze_command_queue_desc_t queueDesc = {
-        .stype      = ZE_STRUCTURE_TYPE_COMMAND_QUEUE_DESC,
-        .pNext      = NULL,
-        .ordinal    = ordinal,
-        .index      = index,
-        .flags      = ZE_COMMAND_QUEUE_FLAG_EXPLICIT_ONLY,
-        .mode       = ZE_COMMAND_QUEUE_MODE_ASYNCHRONOUS,
-        .priority   = ZE_COMMAND_QUEUE_PRIORITY_PRIORITY_LOW
-    };
-    ZE_SAFE_CALL(zeCommandListCreateImmediate(context, device, &queueDesc, &list));
-
-    // events pool
-    ze_event_pool_handle_t pool;
-    const ze_event_pool_desc_t poolDesc = {
-        .stype  = ZE_STRUCTURE_TYPE_EVENT_POOL_DESC,
-        .pNext  = NULL,
-        .flags  = ZE_EVENT_POOL_FLAG_HOST_VISIBLE,
-        .count  = N_TILES
-    };
-    const uint32_t ndevices = 1;
-    ZE_SAFE_CALL(zeEventPoolCreate(context, &poolDesc, ndevices, &device, &pool));
+/**
+ *  Bind the submitting thread as the configuration requests, before host
+ *  memory is allocated, and return in 'node' the node host memory is bound
+ *  to ('-1' to leave it to the first touch). Kinds whose pages the driver
+ *  pins or migrates cannot be moved by 'mbind', and are not placed.
+ */
+static bool
+place(const config_t & c, int * node)
+{
+    *node = -1;
+    if (c.numa == NUMA_PLACEMENT_NONE)
+    {
+        sched_setaffinity(0, sizeof(AFFINITY), &AFFINITY);
+        return true;
+    }
 
-    // events
+    if (c.alloc == HOST_ALLOC_USM || c.alloc == HOST_ALLOC_IMPORT || c.alloc == HOST_ALLOC_SHARED)
+    {
+        LOGGER_WARN("Pages of `%s` host memory are pinned or migrated by the driver, and cannot be bound", HOST_ALLOC_NAMES[c.alloc]);
+        return false;
+    }
+    if (DEVICE_NODE < 0)
+    {
+        LOGGER_WARN("The node of the device is unknown (set `ZE_NUMA_NODE`)");
+        return false;
+    }
+    *node = c.numa == NUMA_PLACEMENT_LOCAL ? DEVICE_NODE : numa_remote_node(DEVICE_NODE);
+    if (*node < 0)
+    {
+        LOGGER_WARN("No node other than the device one");
+        return false;
+    }
+    if (!numa_bind_thread(DEVICE_NODE))
+        return false;
+    numa_where("submit");
+    return true;
+}
+
+// CRC32C of the rows of each host tile
+static std::vector<uint32_t>
+checksums(const config_t & c, const char * hst_mem)
+{
+    const size_t width = c.sx * c.type->size;
+    const size_t pitch = N_TILES * width + c.pad;
+    std::vector<uint32_t> crcs(N_TILES);
+
+    # ifdef _OPENMP
+    #  pragma omp parallel for schedule(dynamic)
+    # endif
     for (unsigned int i = 0 ; i < N_TILES ; ++i)
     {
-        ze_event_desc_t eventDesc = {
-            .stype  = ZE_STRUCTURE_TYPE_EVENT_DESC,
-            .pNext  = NULL,
-            .index  = (uint32_t) i,
-            .signal = ZE_EVENT_SCOPE_FLAG_HOST,
-            .wait   = ZE_EVENT_SCOPE_FLAG_HOST,
-        };
-        ZE_SAFE_CALL(zeEventCreate(pool, &eventDesc, events + i));
+        uint32_t crc = 0;
+        for (uint32_t y = 0 ; y < c.sy ; ++y)
+            crc = memcpy2d_crc32c(crc, hst_mem + y * pitch + i * width, width);
+        crcs[i] = crc;
     }
+    return crcs;
+}
 
-    const size_t n_one = REGION_SX * REGION_SY;
-    const size_t n_all = N_TILES * n_one;
-    const size_t size_one = n_one * sizeof(TYPE);
-    const size_t size_all = n_all * sizeof(TYPE);
+// first differing byte of the tile 'i', as its row and offset in the row, 'false' if none
+static bool
+check_tile(const config_t & c, const char * hst_mem, unsigned int i, uint32_t * row, size_t * offset)
+{
+    const size_t width = c.sx * c.type->size;
+    const size_t pitch = N_TILES * width + c.pad;
+    for (uint32_t y = 0 ; y < c.sy ; ++y)
+    {
+        const size_t off = y * pitch + i * width;
+        const ssize_t bad = c.type->verify(hst_mem + off, off, width);
+        if (bad >= 0)
+        {
+            *row = y;
+            *offset = bad;
+            return true;
+        }
+    }
+    return false;
+}
 
-    // allocate host memory ( tiles are continuous )
-    TYPE * hst_mem = (TYPE *) malloc(size_all);
-    assert(hst_mem);
+/**
+ *  Verify the host tiles copied back, against the fill pattern or against
+ *  their checksums 'crcs' when not empty, and that the row padding (not
+ *  copied back, and set to '0') is untouched. Logs the first differing
+ *  byte of each failing tile.
+ */
+static void
+check(const config_t & c, const char * hst_mem, const std::vector<uint32_t> & crcs)
+{
+    if (CHECK == CHECK_NONE)
+        return ;
+
+    const uint64_t t0 = now();
+    const size_t width = c.sx * c.type->size;
+    const size_t pitch = N_TILES * width + c.pad;
+
+    // per tile, 'true' if it differs
+    std::vector<char> failed(N_TILES, 0);
+    std::vector<uint32_t> rows(N_TILES);
+    std::vector<size_t> offsets(N_TILES);
+    std::vector<uint32_t> received;
+    if (crcs.empty())
+    {
+        # ifdef _OPENMP
+        #  pragma omp parallel for schedule(dynamic)
+        # endif
+        for (unsigned int i = 0 ; i < N_TILES ; ++i)
+            failed[i] = check_tile(c, hst_mem, i, &rows[i], &offsets[i]);
+    }
+    else
+    {
+        received = checksums(c, hst_mem);
+        for (unsigned int i = 0 ; i < N_TILES ; ++i)
+        {
+            if (received[i] == crcs[i])
+                continue ;
+            failed[i] = 1;
+            if (!check_tile(c, hst_mem, i, &rows[i], &offsets[i]))
+                rows[i] = UINT32_MAX;
+        }
+    }
 
-    // write host memory
-    for (size_t i = 0 ; i < n_all ; ++i)
-        hst_mem[i] = i;
-
-    // allocate device memory ( 4 tiles, discontinuous )
-    const ze_device_mem_alloc_desc_t deviceDesc = {
-        .stype   = ZE_STRUCTURE_TYPE_DEVICE_MEMORY_PROPERTIES,
-        .pNext   = NULL,
-        .flags   = 0,
-        .ordinal = 0,
-    };
-    const size_t alignment = REGION_SX * REGION_SY * sizeof(TYPE);
-    TYPE * dev_mem[N_TILES_MAX];
+    unsigned int nfailed = 0;
     for (unsigned int i = 0 ; i < N_TILES ; ++i)
     {
-        ZE_SAFE_CALL(zeMemAllocDevice(context, &deviceDesc, size_one, alignment, device, (void **) &dev_mem[i]));
-        ZE_SAFE_CALL(zeContextMakeMemoryResident(context, device, dev_mem[i], size_one));
+        if (!failed[i])
+            continue ;
+        if (nfailed++ >= CHECK_MAX_REPORTED)
+            continue ;
+        if (rows[i] == UINT32_MAX)
+            LOGGER_ERROR("Tile `%u`: checksum %08x, expected %08x", i, received[i], crcs[i]);
+        else
+            LOGGER_ERROR("Tile `%u`: first difference at row %u, byte %zu (host offset %zu): 0x%02x",
+                    i, rows[i], offsets[i], rows[i] * pitch + i * width + offsets[i],
+                    (unsigned char) hst_mem[rows[i] * pitch + i * width + offsets[i]]);
     }
 
-    //////////////
-    // H2D      //
-    //////////////
+    // padding, as an extra failure
+    for (uint32_t y = 0 ; y < c.sy ; ++y)
+    {
+        const char * pad = hst_mem + y * pitch + N_TILES * width;
+        for (uint32_t b = 0 ; b < c.pad ; ++b)
+        {
+            if (pad[b])
+            {
+                LOGGER_ERROR("Padding of row %u overwritten at byte %u", y, b);
+                ++nfailed;
+                y = c.sy;
+                break ;
+            }
+        }
+    }
 
-    LOGGER_INFO("H2D");
+    LOGGER_DEBUG("Checked with `%s` in %.3lf ms", CHECK_NAMES[crcs.empty() ? CHECK_PATTERN : CHECK_CRC32C], (double) (now() - t0) / 1e6);
+    if (nfailed)
+        LOGGER_FATAL("FAILURE: %u failures over %u tiles (sx=%u sy=%u type=%s tiles=%u pad=%u)",
+                nfailed, N_TILES, c.sx, c.sy, c.type->name, c.ntiles, c.pad);
+}
+
+// run a configuration of the sweep
+static gbs_t
+run(const config_t & c, ze_driver_handle_t driver, ze_context_handle_t context)
+{
+    N_TILES = c.ntiles;
+    LOGGER_DEBUG("Running sx=%u sy=%u type=%s tiles=%u pad=%u offset=%s strategy=%s completion=%s",
+            c.sx, c.sy, c.type->name, c.ntiles, c.pad, c.using_offset ? "origin" : "pointer",
+            COPY_STRATEGY_NAMES[c.strategy], COMPLETION_NAMES[c.completion]);
+    LOGGER_DEBUG("  on %u engines, distribution=%s, alloc=%s", c.nengines, DISTRIBUTION_NAMES[c.distribution],
+            HOST_ALLOC_NAMES[c.alloc]);
+
+    const size_t width    = c.sx * c.type->size;
+    const size_t pitch    = N_TILES * width + c.pad;
+    const size_t size_one = width * c.sy;
+    const size_t size_all = pitch * c.sy;
+
+    // hints are only for 'shared' memory
+    if (c.usm != USM_MIGRATE && c.alloc != HOST_ALLOC_SHARED)
+    {
+        LOGGER_DEBUG("Skipping configuration: `%s` applies to `shared` host memory only", USM_NAMES[c.usm]);
+        return { 0, 0 };
+    }
 
-    // Enqueue 2D copies in the immediate queue H2D
+    // the thread first, so that host memory is allocated from its node
+    int node;
+    if (!place(c, &node))
+    {
+        LOGGER_WARN("Skipping configuration: cannot place memory `%s`", NUMA_PLACEMENT_NAMES[c.numa]);
+        return { 0, 0 };
+    }
+
+    // allocate host memory ( tiles are continuous, rows may be padded )
+    host_alloc_t hst_alloc;
+    if (!host_alloc(c.alloc, driver, context, size_all, &hst_alloc))
+    {
+        LOGGER_WARN("Skipping configuration: no `%s` host memory", HOST_ALLOC_NAMES[c.alloc]);
+        return { 0, 0 };
+    }
+    char * hst_mem = (char *) hst_alloc.ptr;
+
+    // before writing it, so that it is first-touched on its node
+    if (node >= 0 && !numa_bind_memory(hst_mem, size_all, node))
+    {
+        LOGGER_WARN("Skipping configuration: cannot place memory `%s`", NUMA_PLACEMENT_NAMES[c.numa]);
+        host_free(&hst_alloc);
+        return { 0, 0 };
+    }
+
+    // events
+    events.resize(N_TILES);
     for (unsigned int i = 0 ; i < N_TILES ; ++i)
+        events[i] = event_alloc(&EVENTS);
+    for (unsigned int e = 0 ; e < c.nengines ; ++e)
+        tails[e] = event_alloc(&EVENTS);
+    engine_of.resize(N_TILES);
+    completions.resize(N_TILES);
+
+    distribute(c, size_one);
+
+    // 'chunks' spread the tiles on the engines of the configuration only
+    TUNER.nengines = c.nengines;
+
+    // migration hints, before the first touch
+    if (c.alloc == HOST_ALLOC_SHARED && c.usm == USM_ADVISE)
     {
-        # if USING_OFFSET
-        const uint32_t dst_ox = 0;
-        const uint32_t src_ox = i * REGION_SX * sizeof(TYPE);
+        ZE_SAFE_CALL(zeCommandListAppendMemAdvise(ENGINES[0].list, DEVICE, hst_mem, size_all, ZE_MEMORY_ADVICE_SET_PREFERRED_LOCATION));
+        ZE_SAFE_CALL(zeCommandListHostSynchronize(ENGINES[0].list, UINT64_MAX));
+    }
 
-              void * dst    = (      void *) dev_mem[i];
-        const void * src    = (const void *) hst_mem;
+    // write host memory
+    c.type->fill(hst_mem, size_all / c.type->size);
 
-        # else
+    // only read from now on, by the device and the host, when used in place
+    if (c.alloc == HOST_ALLOC_SHARED && c.usm == USM_DIRECT)
+    {
+        ZE_SAFE_CALL(zeCommandListAppendMemAdvise(ENGINES[0].list, DEVICE, hst_mem, size_all, ZE_MEMORY_ADVICE_SET_READ_MOSTLY));
+        ZE_SAFE_CALL(zeCommandListHostSynchronize(ENGINES[0].list, UINT64_MAX));
+    }
 
-        const uint32_t dst_ox = 0;
-        const uint32_t src_ox = 0;
+    // checksum of each tile, before any transfer
+    std::vector<uint32_t> crcs;
+    if (CHECK == CHECK_CRC32C && c.usm != USM_DIRECT)
+        crcs = checksums(c, hst_mem);
 
-              void * dst    = (      void *) dev_mem[i];
-        const void * src    = (const void *) (hst_mem + i * REGION_SX);
+    // allocate device memory ( N_TILES tiles, discontinuous ), the host tiles themselves when used in place
+    std::vector<char *> dev_mem(N_TILES);
+    for (unsigned int i = 0 ; i < N_TILES ; ++i)
+        dev_mem[i] = c.usm == USM_DIRECT ? hst_mem + i * width : (char *) device_pool_alloc(&DEVICE_POOL, size_one);
 
-        # endif
+    std::vector<timing_t> h2d_timings(REPETITIONS);
+    std::vector<timing_t> d2h_timings(REPETITIONS);
+    for (unsigned int r = 0 ; r < WARMUP + REPETITIONS ; ++r)
+    {
+        const timing_t th2d = h2d(c, hst_mem, dev_mem.data());
 
-        const size_t dst_pitch =           REGION_SX * sizeof(TYPE);
-        const size_t src_pitch = N_TILES * REGION_SX * sizeof(TYPE);
+        // Set host memory to 0 before the last D2H, to test correctness (nothing copies it back when used in place)
+        if (r == WARMUP + REPETITIONS - 1 && c.usm != USM_DIRECT)
+            memcpy2d_zero(hst_mem, size_all);
+
+        timing_t td2h;
+        if (c.usm == USM_DIRECT)
+            td2h = d2h_direct(c, hst_mem);
+        else
+        {
+            td2h = d2h(c, hst_mem, dev_mem.data());
+            td2h.touch = touch(c, hst_mem);
+        }
+        if (r >= WARMUP)
+        {
+            h2d_timings[r - WARMUP] = th2d;
+            d2h_timings[r - WARMUP] = td2h;
+        }
+    }
 
-        const size_t width  = REGION_SX * sizeof(TYPE);
-        const size_t height = REGION_SY;
+    //////////////////////
+    // Test correctness //
+    //////////////////////
 
-        copy(i, dst, src, dst_pitch, src_pitch, width, height, dst_ox, src_ox);
+    // nothing was copied back in place
+    if (c.usm == USM_DIRECT)
+        LOGGER_INFO("Not checked: `%s` tiles are used in place", USM_NAMES[c.usm]);
+    else
+        check(c, hst_mem, crcs);
 
-    } /* launch */
+    if (c.completion == COMPLETION_CALLBACK)
+        for (unsigned int k = 0 ; k < ncompletions ; ++k)
+            LOGGER_DEBUG("Tile `%u` completed at rank `%u`", completions[k], k);
 
-    // Poll until completion
-    wait();
+    gbs_t gbs;
+    gbs.h2d = report(c, "h2d", h2d_timings.data(), hst_alloc.alloc_ns);
+    gbs.d2h = report(c, "d2h", d2h_timings.data(), hst_alloc.alloc_ns);
 
-    //////////////
-    // D2H then //
-    //////////////
+    // release host memory
+    host_free(&hst_alloc);
 
-    // Set host memory to 0
-    memset(hst_mem, 0, size_all);
+    // release device memory
+    for (unsigned int i = 0 ; i < N_TILES ; ++i)
+        if (c.usm != USM_DIRECT)
+            device_pool_free(&DEVICE_POOL, dev_mem[i], size_one);
 
-    // D2H - Retrieve memory from device, for the last tile
+    // events
     for (unsigned int i = 0 ; i < N_TILES ; ++i)
+        event_free(&EVENTS, events[i]);
+    for (unsigned int e = 0 ; e < c.nengines ; ++e)
+        event_free(&EVENTS, tails[e]);
+
+    return gbs;
+}
+
+// parse a comma separated list of unsigned integers
+static std::vector<uint32_t>
+parse_list(const char * arg)
+{
+    std::vector<uint32_t> values;
+    char * s = strdup(arg);
+    char * save = NULL;
+    for (char * tok = strtok_r(s, ",", &save) ; tok ; tok = strtok_r(NULL, ",", &save))
+        values.push_back((uint32_t) strtoul(tok, NULL, 0));
+    free(s);
+    return values;
+}
+
+// parse a comma separated list of names, returns their index in 'names'
+static std::vector<uint32_t>
+parse_names(const char * arg, const char * const * names, unsigned int n)
+{
+    std::vector<uint32_t> values;
+    char * s = strdup(arg);
+    char * save = NULL;
+    for (char * tok = strtok_r(s, ",", &save) ; tok ; tok = strtok_r(NULL, ",", &save))
     {
-        # if USING_OFFSET
+        unsigned int i;
+        for (i = 0 ; i < n ; ++i)
+            if (strcmp(tok, names[i]) == 0)
+                break ;
+        if (i == n)
+            LOGGER_FATAL("Unknown value `%s`", tok);
+        values.push_back(i);
+    }
+    free(s);
+    return values;
+}
 
-        const uint32_t dst_ox = i * REGION_SX * sizeof(TYPE);
-        const uint32_t src_ox = 0;
+static void
+usage(const char * name)
+{
+    fprintf(stderr, "usage: %s [-x SX,...] [-y SY,...] [-t TYPE,...] [-n TILES,...] [-p PAD,...] "
+            "[-o origin|pointer,...] [-S region|pointer|rows|chunks|auto,...] [-w WARMUP] [-r REPS] [-c poll|hostsync|spin|tail|callback,...] [-s SPIN] "
+            "[-e ENGINES,...] [-g copy|compute|all] [-d rr|size,...] [-a malloc|usm|import|thp|huge2m|huge1g|shared,...] "
+            "[-u migrate|prefetch|advise|direct,...] [-m tile|pool|vm] [-N none|local|remote,...] [-k pattern|crc32c|none] [-f text|csv|json] [NUMBER_OF_TILES]\n", name);
+}
 
-              void * dst    = (      void *) dev_mem[i];
-        const void * src    = (const void *) hst_mem;
+int
+main(int argc, char ** argv)
+{
+    std::vector<uint32_t> sxs    = { 512 };
+    std::vector<uint32_t> sys    = { 512 };
+    std::vector<uint32_t> types  = { 2 };
+    std::vector<uint32_t> ntiles = { 4 };
+    std::vector<uint32_t> pads   = { 0 };
+    std::vector<uint32_t> offs   = { 0 };
+    std::vector<uint32_t> strategies = { COPY_STRATEGY_REGION };
+    std::vector<uint32_t> completions = { COMPLETION_POLL };
+    std::vector<uint32_t> nengines = { 1 };
+    std::vector<uint32_t> distributions = { DISTRIBUTION_RR };
+    unsigned int groups = 0;
+    std::vector<uint32_t> allocs = { HOST_ALLOC_MALLOC };
+    std::vector<uint32_t> usms   = { USM_MIGRATE };
+    unsigned int devmem = DEVICE_POOL_POOL;
+    std::vector<uint32_t> numas = { NUMA_PLACEMENT_NONE };
+    bool check_set = false;
+
+    const char * type_names[sizeof(TYPES) / sizeof(*TYPES)];
+    for (unsigned int i = 0 ; i < sizeof(TYPES) / sizeof(*TYPES) ; ++i)
+        type_names[i] = TYPES[i].name;
+    const char * offset_names[]  = { "origin", "pointer" };
+    const char * format_names[]  = { "text", "csv", "json" };
+
+    static const struct option options[] = {
+        { "sx",     required_argument, NULL, 'x' },
+        { "sy",     required_argument, NULL, 'y' },
+        { "type",   required_argument, NULL, 't' },
+        { "tiles",  required_argument, NULL, 'n' },
+        { "pad",    required_argument, NULL, 'p' },
+        { "offset", required_argument, NULL, 'o' },
+        { "strategy", required_argument, NULL, 'S' },
+        { "warmup", required_argument, NULL, 'w' },
+        { "reps",   required_argument, NULL, 'r' },
+        { "completion", required_argument, NULL, 'c' },
+        { "spin",   required_argument, NULL, 's' },
+        { "engines", required_argument, NULL, 'e' },
+        { "groups", required_argument, NULL, 'g' },
+        { "dist",   required_argument, NULL, 'd' },
+        { "alloc",  required_argument, NULL, 'a' },
+        { "usm",    required_argument, NULL, 'u' },
+        { "devmem", required_argument, NULL, 'm' },
+        { "numa",   required_argument, NULL, 'N' },
+        { "check",  required_argument, NULL, 'k' },
+        { "format", required_argument, NULL, 'f' },
+        { NULL,     0,                 NULL,  0  }
+    };
 
-        # else
+    int opt;
+    while ((opt = getopt_long(argc, argv, "x:y:t:n:p:o:S:w:r:c:s:e:g:d:a:u:m:N:k:f:", options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case ('x'): sxs     = parse_list(optarg); break ;
+            case ('y'): sys     = parse_list(optarg); break ;
+            case ('t'): types   = parse_names(optarg, type_names, sizeof(type_names) / sizeof(*type_names)); break ;
+            case ('n'): ntiles  = parse_list(optarg); break ;
+            case ('p'): pads    = parse_list(optarg); break ;
+            case ('o'): offs    = parse_names(optarg, offset_names, 2); break ;
+            case ('S'): strategies = parse_names(optarg, COPY_STRATEGY_NAMES, COPY_STRATEGY_MAX); break ;
+            case ('w'): WARMUP  = atoi(optarg); break ;
+            case ('r'): REPETITIONS = atoi(optarg); break ;
+            case ('c'): completions = parse_names(optarg, COMPLETION_NAMES, COMPLETION_MAX); break ;
+            case ('s'): SPIN    = atoi(optarg); break ;
+            case ('e'): nengines = parse_list(optarg); break ;
+            case ('g'): groups  = parse_names(optarg, ZE_ENGINES_NAMES, ZE_ENGINES_MAX)[0]; break ;
+            case ('d'): distributions = parse_names(optarg, DISTRIBUTION_NAMES, DISTRIBUTION_MAX); break ;
+            case ('a'): allocs  = parse_names(optarg, HOST_ALLOC_NAMES, HOST_ALLOC_MAX); break ;
+            case ('u'): usms    = parse_names(optarg, USM_NAMES, USM_MAX); break ;
+            case ('m'): devmem  = parse_names(optarg, DEVICE_POOL_NAMES, DEVICE_POOL_MAX)[0]; break ;
+            case ('N'): numas   = parse_names(optarg, NUMA_PLACEMENT_NAMES, NUMA_PLACEMENT_MAX); break ;
+            case ('k'): CHECK   = (check_t) parse_names(optarg, CHECK_NAMES, CHECK_MAX)[0]; check_set = true; break ;
+            case ('f'): FORMAT  = (format_t) parse_names(optarg, format_names, 3)[0]; break ;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
 
-        const uint32_t dst_ox = 0;
-        const uint32_t src_ox = 0;
+    // backward compatible 'memcpy2d [NUMBER_OF_TILES]'
+    if (optind + 1 == argc)
+        ntiles = parse_list(argv[optind]);
+    else if (optind != argc)
+    {
+        usage(argv[0]);
+        return 1;
+    }
 
-              void * dst    = (      void *) (hst_mem + i * REGION_SX);
-        const void * src    = (const void *) (dev_mem[i]);
+    if (REPETITIONS == 0)
+        REPETITIONS = 1;
 
-        # endif
+    for (uint32_t n : ntiles)
+        if (n == 0)
+            LOGGER_FATAL("The number of tiles must be at least 1");
 
-        const size_t dst_pitch = N_TILES * REGION_SX * sizeof(TYPE);
-        const size_t src_pitch =           REGION_SX * sizeof(TYPE);
+    // the null driver performs no copy
+    const char * null_driver = getenv("ZE_ENABLE_NULL_DRIVER");
+    if (null_driver && atoi(null_driver) && !check_set)
+    {
+        LOGGER_WARN("Null driver: copies are not verified (`-k` to force)");
+        CHECK = CHECK_NONE;
+    }
 
-        const size_t width  = REGION_SX * sizeof(TYPE);
-        const size_t height = REGION_SY;
+    //////////////
+    //  INIT    //
+    //////////////
+
+    LOGGER_INFO("Init");
 
-        copy(i, dst, src, dst_pitch, src_pitch, width, height, dst_ox, src_ox);
-    } /* launch */
+    ze_device_t ze;
+    ze_device_init(&ze);
+    ze_driver_handle_t  driver  = ze.driver;
+    ze_device_handle_t  device  = ze.device;
+    DEVICE = device;
+    ze_context_handle_t context = ze.context;
 
-    wait();
+    // engines of the selected groups
+    N_ENGINES = ze_device_engines(&ze, (ze_engines_t) groups, ENGINES, N_ENGINES_MAX);
+    if (N_ENGINES == 0)
+        LOGGER_FATAL("No engine in the `%s` queue groups", ZE_ENGINES_NAMES[groups]);
+    LOGGER_INFO("Using %u engines", N_ENGINES);
 
-    //////////////////////
-    // Test correctness //
-    //////////////////////
+    for (uint32_t & n : nengines)
+    {
+        if (n == 0 || n > N_ENGINES)
+        {
+            LOGGER_WARN("`%u` engines requested, using `%u`", n, N_ENGINES);
+            n = N_ENGINES;
+        }
+    }
+
+    // node of the device
+    DEVICE_NODE = ze_device_numa_node(device);
+    sched_getaffinity(0, sizeof(AFFINITY), &AFFINITY);
+    LOGGER_INFO("Device on node %d, of %d nodes", DEVICE_NODE, numa_nodes());
+
+    // events
+    event_allocator_init(&EVENTS, context, device, 64, false);
+
+    // copy strategies, tuned ones of previous runs
+    copy_tuner_init(&TUNER, &ze, ENGINES, N_ENGINES, &EVENTS);
+
+    // device memory
+    device_pool_init(&DEVICE_POOL, (device_pool_kind_t) devmem, context, device, DEVICE_POOL_SLAB, DEVICE_POOL_ALIGNMENT);
+
+    //////////////
+    //  SWEEP   //
+    //////////////
+
+    LOGGER_INFO("Sweeping over %zu configurations",
+            sxs.size() * sys.size() * types.size() * ntiles.size() * pads.size() * offs.size() * strategies.size() * completions.size() *
+            nengines.size() * distributions.size() * allocs.size() * usms.size() * numas.size());
+
+    for (uint32_t t : types)
+        for (uint32_t n : ntiles)
+            for (uint32_t sy : sys)
+                for (uint32_t sx : sxs)
+                    for (uint32_t pad : pads)
+                        for (uint32_t o : offs)
+                            for (uint32_t st : strategies)
+                                for (uint32_t w : completions)
+                                    for (uint32_t e : nengines)
+                                        for (uint32_t d : distributions)
+                                            for (uint32_t a : allocs)
+                                                for (uint32_t u : usms)
+                                                {
+                                                    gbs_t gbs[NUMA_PLACEMENT_MAX] = {};
+                                                    for (uint32_t m : numas)
+                                                        gbs[m] = run({ sx, sy, TYPES + t, n, pad, o == 0, (copy_strategy_t) st, (completion_t) w, e,
+                                                                (distribution_t) d, (host_alloc_kind_t) a, (usm_t) u, (numa_placement_t) m },
+                                                                driver, context);
+
+                                                    const gbs_t & local  = gbs[NUMA_PLACEMENT_LOCAL];
+                                                    const gbs_t & remote = gbs[NUMA_PLACEMENT_REMOTE];
+                                                    if (local.h2d > 0 && remote.h2d > 0)
+                                                        LOGGER_INFO("local / remote bandwidth: h2d %.2lfx, d2h %.2lfx",
+                                                                local.h2d / remote.h2d, local.d2h / remote.d2h);
+                                                }
+
+    if (FORMAT == FORMAT_JSON)
+        printf("%s]\n", NRESULTS ? "\n" : "[\n");
 
-    for (size_t j = 0 ; j < N_TILES * REGION_SX * REGION_SY ; ++j)
-        if (hst_mem[j] != j)
-            LOGGER_FATAL("FAILURE");
     LOGGER_INFO("SUCCESS");
 
     //////////////
@@ -352,21 +1269,23 @@ main(int argc, char ** argv)
 
     LOGGER_INFO("Deinit");
 
-    // release host memory
-    free(hst_mem);
+    // device memory
+    LOGGER_DEBUG("Device `%s` memory: %u tiles allocated, %u recycled, %zu slabs",
+            DEVICE_POOL_NAMES[devmem], DEVICE_POOL.nallocs, DEVICE_POOL.nrecycled, DEVICE_POOL.slabs.size());
+    device_pool_deinit(&DEVICE_POOL);
 
-    // release device memory
-    for (unsigned int i = 0 ; i < N_TILES ; ++i)
-        ZE_SAFE_CALL(zeMemFree(context, dev_mem[i]));
+    // copy strategies
+    copy_tuner_deinit(&TUNER);
 
-    // command list
-    ZE_SAFE_CALL(zeCommandListDestroy(list));
+    // events
+    LOGGER_DEBUG("%u events in %zu pools", event_allocator_size(&EVENTS), EVENTS.pools.size());
+    event_allocator_deinit(&EVENTS);
 
-    // event pool
-    ZE_SAFE_CALL(zeEventPoolDestroy(pool));
+    // command lists
+    ze_device_engines_release(ENGINES, N_ENGINES);
 
     // context
-    ZE_SAFE_CALL(zeContextDestroy(context));
+    ze_device_deinit(&ze);
 
     // device ?
 
@@ -4,6 +4,7 @@
 # include <string.h>
 # include <ze_api.h>
 # include <zes_api.h>
+# define LOGGER_HEADER "ZES-LEAK"
 # include "logger-ze.h"
 
 # define ZE_MAX_DRIVERS     4
@@ -0,0 +1,255 @@
+/**
+ *  Read-mostly scalability benchmark.
+ *
+ *  A shared record of 'N_FIELDS' words (e.g. a time base) is protected by:
+ *      - spinlock  : 'spinlock_t', readers serialize
+ *      - rw-reader : 'rwlock_reader_pref_t'
+ *      - rw-writer : 'rwlock_writer_pref_t'
+ *      - seqlock   : 'seqlock_t', readers do not write shared memory
+ *
+ *  For 1, 2, 4, ... up to MAX_THREADS reader threads (pinned to the cores of
+ *  the process affinity), each reader copies the record N_READS times and
+ *  checks its consistency, while one writer thread (pinned to the last core)
+ *  updates the record every 'WRITE_PERIOD' pauses until readers are done.
+ *
+ *  Reports the aggregated reader throughput and the number of writes.
+ *
+ *  usage: rwlock-bench [MAX_THREADS] [N_READS]
+ */
+
+# ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+# endif /* _GNU_SOURCE */
+# include <sched.h>
+
+# include <assert.h>
+# include <pthread.h>
+# include <stdio.h>
+# include <stdlib.h>
+# include <time.h>
+
+# include "rwlock.h"
+# include "seqlock.h"
+# include "spinlock.h"
+
+// number of words of the shared record
+# define N_FIELDS 8
+
+// number of 'pause' between two writes
+# define WRITE_PERIOD 1024
+
+static volatile uint64_t record[N_FIELDS];
+
+static unsigned int N_READS;
+
+// cpus of the process affinity
+static int      ncpus;
+static int      cpus[CPU_SETSIZE];
+
+static inline uint64_t
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static void
+pin(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// same 'read(f)' / 'write(f)' interface for every primitive
+
+class sync_spinlock_t
+{
+    public:
+        template <typename F> void read(F f)  { SPINLOCK_LOCK(this->l); f(); SPINLOCK_UNLOCK(this->l); }
+        template <typename F> void write(F f) { SPINLOCK_LOCK(this->l); f(); SPINLOCK_UNLOCK(this->l); }
+    private:
+        spinlock_t l = SPINLOCK_INITIALIZER;
+};
+
+template <typename RW>
+class sync_rwlock_t
+{
+    public:
+        template <typename F> void read(F f)  { this->l.read_lock();  f(); this->l.read_unlock();  }
+        template <typename F> void write(F f) { this->l.write_lock(); f(); this->l.write_unlock(); }
+    private:
+        RW l;
+};
+
+class sync_seqlock_t
+{
+    public:
+        template <typename F>
+        void
+        read(F f)
+        {
+            uint32_t seq;
+            do {
+                seq = this->l.read_begin();
+                f();
+            } while (this->l.read_retry(seq));
+        }
+
+        template <typename F> void write(F f) { this->l.write_lock(); f(); this->l.write_unlock(); }
+
+    private:
+        seqlock_t l;
+};
+
+template <typename S>
+struct  bench_s
+{
+    S sync;
+    pthread_barrier_t barrier;
+    volatile int done;
+    uint64_t writes;
+    uint64_t starts[CPU_SETSIZE];
+    uint64_t ends[CPU_SETSIZE];
+};
+
+template <typename S>
+struct  bench_args_s
+{
+    struct bench_s<S> * bench;
+    unsigned int tid;
+};
+
+template <typename S>
+static void *
+reader(void * args)
+{
+    struct bench_args_s<S> * a = (struct bench_args_s<S> *) args;
+    struct bench_s<S> * b = a->bench;
+    pin(cpus[a->tid % ncpus]);
+
+    pthread_barrier_wait(&b->barrier);
+    b->starts[a->tid] = now();
+    for (unsigned int i = 0 ; i < N_READS ; ++i)
+    {
+        uint64_t copy[N_FIELDS];
+        b->sync.read([&] {
+            for (unsigned int j = 0 ; j < N_FIELDS ; ++j)
+                copy[j] = record[j];
+        });
+        for (unsigned int j = 1 ; j < N_FIELDS ; ++j)
+        {
+            if (copy[j] != copy[0])
+            {
+                fprintf(stderr, "Inconsistent read: %lu != %lu\n", copy[j], copy[0]);
+                abort();
+            }
+        }
+    }
+    b->ends[a->tid] = now();
+
+    return NULL;
+}
+
+template <typename S>
+static void *
+writer(void * args)
+{
+    struct bench_s<S> * b = (struct bench_s<S> *) args;
+    pin(cpus[ncpus - 1]);
+
+    pthread_barrier_wait(&b->barrier);
+    uint64_t v = 0;
+    while (!b->done)
+    {
+        ++v;
+        b->sync.write([&] {
+            for (unsigned int j = 0 ; j < N_FIELDS ; ++j)
+                record[j] = v;
+        });
+        for (unsigned int j = 0 ; j < WRITE_PERIOD ; ++j)
+            mem_pause();
+    }
+    b->writes = v;
+
+    return NULL;
+}
+
+template <typename S>
+static void
+bench(const char * name, unsigned int nthreads)
+{
+    struct bench_s<S> * b = new struct bench_s<S>;
+    b->done = 0;
+    pthread_barrier_init(&b->barrier, NULL, nthreads + 2);
+
+    for (unsigned int j = 0 ; j < N_FIELDS ; ++j)
+        record[j] = 0;
+
+    pthread_t w;
+    pthread_create(&w, NULL, writer<S>, b);
+
+    pthread_t threads[nthreads];
+    struct bench_args_s<S> args[nthreads];
+    for (unsigned int i = 0 ; i < nthreads ; ++i)
+    {
+        args[i].bench = b;
+        args[i].tid = i;
+        pthread_create(threads + i, NULL, reader<S>, args + i);
+    }
+
+    // start, and wait for readers
+    pthread_barrier_wait(&b->barrier);
+    for (unsigned int i = 0 ; i < nthreads ; ++i)
+        pthread_join(threads[i], NULL);
+    b->done = 1;
+    pthread_join(w, NULL);
+    pthread_barrier_destroy(&b->barrier);
+
+    uint64_t t0 = b->starts[0], tf = b->ends[0];
+    for (unsigned int i = 1 ; i < nthreads ; ++i)
+    {
+        if (b->starts[i] < t0) t0 = b->starts[i];
+        if (b->ends[i]   > tf) tf = b->ends[i];
+    }
+
+    const double rate = (double) nthreads * N_READS / ((double) (tf - t0) / 1e9);
+    printf("%-10s %8u %16.0lf %12lu\n", name, nthreads, rate, b->writes);
+    fflush(stdout);
+
+    delete b;
+}
+
+int
+main(int argc, char ** argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s [MAX_THREADS] [N_READS]\n", argv[0]);
+        return 1;
+    }
+
+    const unsigned int max_threads = atoi(argv[1]);
+    N_READS = atoi(argv[2]);
+    assert(max_threads <= CPU_SETSIZE);
+
+    cpu_set_t set;
+    sched_getaffinity(0, sizeof(set), &set);
+    ncpus = 0;
+    for (int cpu = 0 ; cpu < CPU_SETSIZE ; ++cpu)
+        if (CPU_ISSET(cpu, &set))
+            cpus[ncpus++] = cpu;
+
+    printf("%-10s %8s %16s %12s\n", "sync", "readers", "reads/s", "writes");
+    for (unsigned int nthreads = 1 ; nthreads <= max_threads ; nthreads *= 2)
+    {
+        bench<sync_spinlock_t>                      ("spinlock",  nthreads);
+        bench<sync_rwlock_t<rwlock_reader_pref_t>>  ("rw-reader", nthreads);
+        bench<sync_rwlock_t<rwlock_writer_pref_t>>  ("rw-writer", nthreads);
+        bench<sync_seqlock_t>                       ("seqlock",   nthreads);
+    }
+
+    return 0;
+}
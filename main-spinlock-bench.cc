@@ -0,0 +1,230 @@
+/**
+ *  Lock contention benchmark.
+ *
+ *  For every lock of the spinlock.h family, for 1, 2, 4, ... up to
+ *  MAX_THREADS threads (each pinned to a distinct core of the process
+ *  affinity, round-robin if there are more threads than cores), and for
+ *  several critical section lengths, each thread acquires the lock
+ *  N_ACQUISITIONS times. In the critical section, a thread increments
+ *  'CS_LEN' shared counters (so that protected data moves along with the
+ *  lock), and outside of it, it does some private work.
+ *
+ *  Then, oversubscribes every core with 2 and 4 threads, to compare the
+ *  locks parking their waiters (mutex, futex) with the spinning ones when
+ *  lock holders get descheduled. Queued locks are left out of this pass, as
+ *  their FIFO handoff to a descheduled waiter makes it last forever.
+ *
+ *  Reports the number of acquisitions per second, the ratio between the
+ *  slowest and the fastest thread completion time (1.0 is perfectly fair),
+ *  and the process cpu time over the wall time (the number of cores burnt).
+ *
+ *  usage: spinlock-bench [MAX_THREADS] [N_ACQUISITIONS]
+ */
+
+# ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+# endif /* _GNU_SOURCE */
+# include <sched.h>
+
+# include <assert.h>
+# include <pthread.h>
+# include <stdio.h>
+# include <stdlib.h>
+# include <time.h>
+
+# include "spinlock.h"
+
+// critical section lengths, in shared counters incremented
+static const unsigned int CS_LENS[] = { 0, 4, 64, 1024 };
+
+// private work between two acquisitions, in 'pause'
+# define NON_CS_LEN 64
+
+// maximum critical section length
+# define CS_LEN_MAX 1024
+
+static volatile uint64_t shared[CS_LEN_MAX];
+
+static unsigned int N_ACQUISITIONS;
+
+// cpus of the process affinity
+static int      ncpus;
+static int      cpus[CPU_SETSIZE];
+
+static inline uint64_t
+now_clock(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static inline uint64_t
+now(void)
+{
+    return now_clock(CLOCK_MONOTONIC);
+}
+
+static void
+pin(unsigned int tid)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[tid % ncpus], &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+template <typename L>
+struct  bench_s
+{
+    L lock;
+    unsigned int cs_len;
+    pthread_barrier_t barrier;
+    uint64_t starts[CPU_SETSIZE];
+    uint64_t ends[CPU_SETSIZE];
+};
+
+template <typename L>
+struct  bench_args_s
+{
+    struct bench_s<L> * bench;
+    unsigned int tid;
+};
+
+template <typename L>
+static void *
+run(void * args)
+{
+    struct bench_args_s<L> * a = (struct bench_args_s<L> *) args;
+    struct bench_s<L> * b = a->bench;
+    pin(a->tid);
+
+    pthread_barrier_wait(&b->barrier);
+    b->starts[a->tid] = now();
+    for (unsigned int i = 0 ; i < N_ACQUISITIONS ; ++i)
+    {
+        {
+            spinlock_guard<L> guard(b->lock);
+            for (unsigned int j = 0 ; j < b->cs_len ; ++j)
+                shared[j] = shared[j] + 1;
+        }
+        for (unsigned int j = 0 ; j < NON_CS_LEN ; ++j)
+            mem_pause();
+    }
+    b->ends[a->tid] = now();
+    pthread_barrier_wait(&b->barrier);
+
+    return NULL;
+}
+
+template <typename L>
+static void
+bench(const char * name, unsigned int nthreads, unsigned int cs_len)
+{
+    struct bench_s<L> * b = new struct bench_s<L>;
+    b->cs_len = cs_len;
+    pthread_barrier_init(&b->barrier, NULL, nthreads + 1);
+
+    for (unsigned int j = 0 ; j < cs_len ; ++j)
+        shared[j] = 0;
+
+    pthread_t threads[nthreads];
+    struct bench_args_s<L> args[nthreads];
+    for (unsigned int i = 0 ; i < nthreads ; ++i)
+    {
+        args[i].bench = b;
+        args[i].tid = i;
+        pthread_create(threads + i, NULL, run<L>, args + i);
+    }
+
+    uint64_t c0 = now_clock(CLOCK_PROCESS_CPUTIME_ID);
+    pthread_barrier_wait(&b->barrier);
+    pthread_barrier_wait(&b->barrier);
+    uint64_t cf = now_clock(CLOCK_PROCESS_CPUTIME_ID);
+
+    for (unsigned int i = 0 ; i < nthreads ; ++i)
+        pthread_join(threads[i], NULL);
+    pthread_barrier_destroy(&b->barrier);
+
+    // check mutual exclusion
+    for (unsigned int j = 0 ; j < cs_len ; ++j)
+    {
+        if (shared[j] != (uint64_t) nthreads * N_ACQUISITIONS)
+        {
+            fprintf(stderr, "`%s` is broken: %lu != %lu\n", name, shared[j], (uint64_t) nthreads * N_ACQUISITIONS);
+            abort();
+        }
+    }
+
+    // wall time from the first thread start to the last thread end
+    uint64_t t0 = b->starts[0], tf = b->ends[0];
+    uint64_t tmin = tf - t0, tmax = tf - t0;
+    for (unsigned int i = 1 ; i < nthreads ; ++i)
+    {
+        const uint64_t t = b->ends[i] - b->starts[i];
+        if (t < tmin) tmin = t;
+        if (t > tmax) tmax = t;
+        if (b->starts[i] < t0) t0 = b->starts[i];
+        if (b->ends[i]   > tf) tf = b->ends[i];
+    }
+
+    const double rate = (double) nthreads * N_ACQUISITIONS / ((double) (tf - t0) / 1e9);
+    printf("%-8s %8u %8u %16.0lf %10.2lf %10.2lf\n", name, nthreads, cs_len, rate,
+            (double) tmax / (double) tmin, (double) (cf - c0) / (double) (tf - t0));
+    fflush(stdout);
+
+    delete b;
+}
+
+int
+main(int argc, char ** argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s [MAX_THREADS] [N_ACQUISITIONS]\n", argv[0]);
+        return 1;
+    }
+
+    const unsigned int max_threads = atoi(argv[1]);
+    N_ACQUISITIONS = atoi(argv[2]);
+    assert(max_threads <= CPU_SETSIZE);
+
+    cpu_set_t set;
+    sched_getaffinity(0, sizeof(set), &set);
+    ncpus = 0;
+    for (int cpu = 0 ; cpu < CPU_SETSIZE ; ++cpu)
+        if (CPU_ISSET(cpu, &set))
+            cpus[ncpus++] = cpu;
+
+    printf("%-8s %8s %8s %16s %10s %10s\n", "lock", "threads", "cs", "acq/s", "max/min", "cpu/wall");
+    for (unsigned int c = 0 ; c < sizeof(CS_LENS) / sizeof(*CS_LENS) ; ++c)
+    {
+        for (unsigned int nthreads = 1 ; nthreads <= max_threads ; nthreads *= 2)
+        {
+            bench<spinlock_tas_t>   ("tas",     nthreads, CS_LENS[c]);
+            bench<spinlock_ttas_t>  ("ttas",    nthreads, CS_LENS[c]);
+            bench<spinlock_ticket_t>("ticket",  nthreads, CS_LENS[c]);
+            bench<spinlock_mcs_t>   ("mcs",     nthreads, CS_LENS[c]);
+            bench<spinlock_clh_t>   ("clh",     nthreads, CS_LENS[c]);
+            bench<spinlock_mutex_t> ("mutex",   nthreads, CS_LENS[c]);
+            bench<spinlock_futex_t> ("futex",   nthreads, CS_LENS[c]);
+        }
+    }
+
+    // oversubscription
+    for (unsigned int c = 0 ; c < sizeof(CS_LENS) / sizeof(*CS_LENS) ; ++c)
+    {
+        for (unsigned int k = 2 ; k <= 4 ; k *= 2)
+        {
+            const unsigned int nthreads = k * ncpus;
+            if (nthreads > CPU_SETSIZE)
+                break ;
+            bench<spinlock_tas_t>   ("tas",     nthreads, CS_LENS[c]);
+            bench<spinlock_ttas_t>  ("ttas",    nthreads, CS_LENS[c]);
+            bench<spinlock_mutex_t> ("mutex",   nthreads, CS_LENS[c]);
+            bench<spinlock_futex_t> ("futex",   nthreads, CS_LENS[c]);
+        }
+    }
+
+    return 0;
+}
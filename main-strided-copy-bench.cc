@@ -0,0 +1,501 @@
+/**
+ *  Throughput of strided copies (see strided-copy.h) of 2D and 3D boxes,
+ *  as a single region or as a batch of regions, and of halo exchanges.
+ *
+ *  For each shape 'X'x'Y'x'Z' (in floats), a box is copied from a padded
+ *  source array (pitches of the box plus 'PAD' bytes and rows) to a dense
+ *  destination:
+ *      - box       a single 3D region
+ *      - slices    a batch of 'Z' 2D regions, one per slice
+ *      - halo      the 6 faces exchange of a periodic field of 'X'x'Y'x'Z'
+ *                  floats with 'HALO' layers, within the destination
+ *  Reports the median time and the bandwidth over the bytes of the regions.
+ *
+ *  Backends:
+ *      - host      'strided_copy_host', no device needed
+ *      - ze        'strided_copy_ze' on an immediate command list, from
+ *                  'zeMemAllocHost' memory to device memory
+ *
+ *  With '-c', runs a self-check before the benchmark instead: random
+ *  regions and batches, and halo exchanges, are copied by the backend and
+ *  compared with a byte by byte reference copy on the host.
+ *
+ *  usage: strided-copy-bench [-b host|ze] [-s XxYxZ,...] [-H HALO] [-r REPS] [-c]
+ */
+
+# include <getopt.h>
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+# include <ze_api.h>
+
+# include <vector>
+
+# define LOGGER_HEADER "STRIDED-COPY-BENCH"
+# include "logger-ze.h"
+# include "strided-copy.h"
+# include "ze-device.h"
+
+// padding of the source array, in bytes per row and in rows per slice
+# define PAD 64
+
+typedef enum    backend_e
+{
+    BACKEND_HOST,
+    BACKEND_ZE,
+    BACKEND_MAX
+}               backend_t;
+
+static const char * BACKEND_NAMES[BACKEND_MAX] = {
+    "host",
+    "ze"
+};
+
+typedef struct  shape_s
+{
+    uint32_t x, y, z;
+}               shape_t;
+
+static backend_t BACKEND = BACKEND_HOST;
+static unsigned int REPETITIONS = 10;
+static uint32_t HALO = 1;
+
+// device state of the 'ze' backend
+static ze_device_t ZE;
+static ze_engine_t ENGINE;
+static ze_event_pool_handle_t POOL;
+static ze_event_handle_t DONE;
+
+static inline uint64_t
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static int
+cmp(const void * a, const void * b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+//////////////////
+//  BACKENDS    //
+//////////////////
+
+// memory the copies read from, accessible by the host
+static char *
+src_alloc(size_t size)
+{
+    void * ptr;
+    if (BACKEND == BACKEND_HOST)
+        ptr = aligned_alloc(4096, (size + 4095) / 4096 * 4096);
+    else
+    {
+        const ze_host_mem_alloc_desc_t hostDesc = {
+            .stype = ZE_STRUCTURE_TYPE_HOST_MEM_ALLOC_DESC,
+            .pNext = NULL,
+            .flags = 0
+        };
+        ZE_SAFE_CALL(zeMemAllocHost(ZE.context, &hostDesc, size, 4096, &ptr));
+    }
+    if (ptr == NULL)
+        LOGGER_FATAL("Cannot allocate %zu bytes", size);
+    return (char *) ptr;
+}
+
+// memory the copies write to, device memory for the 'ze' backend
+static char *
+dst_alloc(size_t size)
+{
+    if (BACKEND == BACKEND_HOST)
+        return src_alloc(size);
+
+    void * ptr;
+    const ze_device_mem_alloc_desc_t deviceDesc = {
+        .stype   = ZE_STRUCTURE_TYPE_DEVICE_MEM_ALLOC_DESC,
+        .pNext   = NULL,
+        .flags   = 0,
+        .ordinal = 0,
+    };
+    ZE_SAFE_CALL(zeMemAllocDevice(ZE.context, &deviceDesc, size, 4096, ZE.device, &ptr));
+    return (char *) ptr;
+}
+
+static void
+mem_free(void * ptr)
+{
+    if (BACKEND == BACKEND_HOST)
+        free(ptr);
+    else
+        ZE_SAFE_CALL(zeMemFree(ZE.context, ptr));
+}
+
+// copy a batch of regions, and wait for it
+static void
+copy(const strided_region_t * regions, unsigned int n)
+{
+    if (BACKEND == BACKEND_HOST)
+    {
+        strided_copy_host(regions, n);
+        return ;
+    }
+    strided_copy_ze(ENGINE.list, regions, n, DONE, 0, NULL);
+    ZE_SAFE_CALL(zeEventHostSynchronize(DONE, UINT64_MAX));
+    ZE_SAFE_CALL(zeEventHostReset(DONE));
+}
+
+// linear copy of 'size' bytes, between host and 'dst_alloc' memory
+static void
+copy_linear(void * dst, const void * src, size_t size)
+{
+    const strided_region_t r = strided_region_2d(dst, src, size, size, size, 1);
+    copy(&r, 1);
+}
+
+//////////////////
+//  SELF-CHECK  //
+//////////////////
+
+// byte by byte copy of a region, on the host
+static void
+reference(const strided_region_t & r)
+{
+    for (uint32_t z = 0 ; z < r.depth ; ++z)
+        for (uint32_t y = 0 ; y < r.height ; ++y)
+            for (uint32_t x = 0 ; x < r.width ; ++x)
+                ((char *) r.dst)[(r.dst_z + z) * r.dst_slice_pitch + (r.dst_y + y) * r.dst_pitch + r.dst_x + x] =
+                    ((const char *) r.src)[(r.src_z + z) * r.src_slice_pitch + (r.src_y + y) * r.src_pitch + r.src_x + x];
+}
+
+// a random region between two buffers, returns the bytes of each buffer
+static strided_region_t
+random_region(bool is3d, size_t * dst_size, size_t * src_size)
+{
+    strided_region_t r;
+    r.width  = 1 + rand() % 67;
+    r.height = 1 + rand() % 9;
+    r.depth  = is3d ? 1 + rand() % 5 : 1;
+    r.dst_x  = rand() % 13;
+    r.src_x  = rand() % 13;
+    r.dst_y  = rand() % 3;
+    r.src_y  = rand() % 3;
+    r.dst_z  = is3d ? rand() % 3 : 0;
+    r.src_z  = is3d ? rand() % 3 : 0;
+    r.dst_pitch = r.dst_x + r.width + rand() % 17;
+    r.src_pitch = r.src_x + r.width + rand() % 17;
+    r.dst_slice_pitch = is3d ? r.dst_pitch * (r.dst_y + r.height + rand() % 3) : 0;
+    r.src_slice_pitch = is3d ? r.src_pitch * (r.src_y + r.height + rand() % 3) : 0;
+    *dst_size = is3d ? r.dst_slice_pitch * (r.dst_z + r.depth) : r.dst_pitch * (r.dst_y + r.height);
+    *src_size = is3d ? r.src_slice_pitch * (r.src_z + r.depth) : r.src_pitch * (r.src_y + r.height);
+    return r;
+}
+
+// copy batches of random regions, each to its own part of the destination
+static unsigned int
+check_regions(unsigned int ncases)
+{
+    unsigned int nfailed = 0;
+    for (unsigned int k = 0 ; k < ncases ; ++k)
+    {
+        const bool is3d = k % 2;
+        const unsigned int n = 1 + rand() % 4;
+        std::vector<strided_region_t> regions(n);
+        std::vector<size_t> dst_offset(n + 1, 0);
+        std::vector<size_t> src_offset(n + 1, 0);
+        for (unsigned int i = 0 ; i < n ; ++i)
+        {
+            size_t dst_size, src_size;
+            regions[i] = random_region(is3d, &dst_size, &src_size);
+            dst_offset[i + 1] = dst_offset[i] + dst_size;
+            src_offset[i + 1] = src_offset[i] + src_size;
+        }
+
+        char * src      = src_alloc(src_offset[n]);
+        char * dst      = dst_alloc(dst_offset[n]);
+        char * expected = (char *) calloc(1, dst_offset[n]);
+        char * got      = src_alloc(dst_offset[n]);
+        for (size_t b = 0 ; b < src_offset[n] ; ++b)
+            src[b] = (char) rand();
+        memset(got, 0, dst_offset[n]);
+        copy_linear(dst, got, dst_offset[n]);
+
+        // the same regions, to the device and to the reference
+        std::vector<strided_region_t> mirrors(regions);
+        for (unsigned int i = 0 ; i < n ; ++i)
+        {
+            regions[i].dst = dst      + dst_offset[i];
+            regions[i].src = src      + src_offset[i];
+            mirrors[i].dst = expected + dst_offset[i];
+            mirrors[i].src = src      + src_offset[i];
+            reference(mirrors[i]);
+        }
+        copy(regions.data(), n);
+        copy_linear(got, dst, dst_offset[n]);
+
+        if (memcmp(got, expected, dst_offset[n]))
+        {
+            const strided_region_t & r = regions[0];
+            LOGGER_ERROR("Case `%u` (%s, %u regions) differs, first region %ux%ux%u from (%u, %u, %u) to (%u, %u, %u)",
+                    k, is3d ? "3d" : "2d", n, r.width, r.height, r.depth,
+                    r.src_x, r.src_y, r.src_z, r.dst_x, r.dst_y, r.dst_z);
+            ++nfailed;
+        }
+
+        free(expected);
+        mem_free(got);
+        mem_free(dst);
+        mem_free(src);
+    }
+    return nfailed;
+}
+
+// exchange the halo of a periodic field, and check each halo face against the interior
+static unsigned int
+check_halo(uint32_t nx, uint32_t ny, uint32_t nz, uint32_t h)
+{
+    strided_field_t host = strided_field(NULL, sizeof(int), nx, ny, nz, h);
+    const size_t size = strided_field_size(&host);
+    host.ptr = src_alloc(size);
+    for (size_t i = 0 ; i < size / sizeof(int) ; ++i)
+        ((int *) host.ptr)[i] = (int) i;
+
+    strided_field_t field = host;
+    field.ptr = dst_alloc(size);
+    copy_linear(field.ptr, host.ptr, size);
+
+    const strided_field_t * neighbours[STRIDED_FACE_MAX];
+    for (int face = 0 ; face < STRIDED_FACE_MAX ; ++face)
+        neighbours[face] = &field;
+    strided_region_t regions[STRIDED_FACE_MAX];
+    strided_halo_regions(&field, neighbours, regions);
+    copy(regions, STRIDED_FACE_MAX);
+    copy_linear(host.ptr, field.ptr, size);
+
+    // storage coordinates of the halo cells of each face, and of the interior cell sent there
+    const uint32_t n[3] = { nx, ny, nz };
+    unsigned int nfailed = 0;
+    for (int face = 0 ; face < STRIDED_FACE_MAX ; ++face)
+    {
+        const unsigned int axis = face / 2;
+        uint32_t lo[3] = { h, h, h };
+        uint32_t hi[3] = { h + nx, h + ny, h + nz };
+        lo[axis] = face % 2 ? 0 : h + n[axis];
+        hi[axis] = lo[axis] + h;
+        for (uint32_t z = lo[2] ; z < hi[2] ; ++z)
+            for (uint32_t y = lo[1] ; y < hi[1] ; ++y)
+                for (uint32_t x = lo[0] ; x < hi[0] ; ++x)
+                {
+                    uint32_t c[3] = { x, y, z };
+                    c[axis] = face % 2 ? c[axis] + n[axis] : c[axis] - n[axis];
+                    const int got      = *(int *) (host.ptr + z * host.slice_pitch + y * host.pitch + x * sizeof(int));
+                    const int expected = (int) ((c[2] * host.slice_pitch + c[1] * host.pitch + c[0] * sizeof(int)) / sizeof(int));
+                    if (got != expected)
+                    {
+                        LOGGER_ERROR("Halo %s of %ux%ux%u (halo %u) differs at (%u, %u, %u)",
+                                STRIDED_FACE_NAMES[face], nx, ny, nz, h, x, y, z);
+                        ++nfailed;
+                        z = hi[2]; y = hi[1];
+                        break ;
+                    }
+                }
+    }
+
+    mem_free(field.ptr);
+    mem_free(host.ptr);
+    return nfailed;
+}
+
+static void
+self_check(void)
+{
+    srand(42);
+    unsigned int nfailed = check_regions(200);
+    const uint32_t shapes[][4] = { { 4, 4, 4, 1 }, { 7, 5, 3, 2 }, { 16, 1, 9, 1 }, { 3, 8, 8, 3 } };
+    for (const uint32_t * s : shapes)
+        nfailed += check_halo(s[0], s[1], s[2], s[3]);
+
+    if (nfailed)
+        LOGGER_FATAL("Self-check FAILURE: %u cases differ on backend `%s`", nfailed, BACKEND_NAMES[BACKEND]);
+    LOGGER_INFO("Self-check SUCCESS on backend `%s`", BACKEND_NAMES[BACKEND]);
+}
+
+//////////////////
+//  BENCHMARK   //
+//////////////////
+
+// median time of a batch of regions over 'REPETITIONS' runs, after a warmup
+static uint64_t
+measure(const strided_region_t * regions, unsigned int n)
+{
+    std::vector<uint64_t> ns(REPETITIONS);
+    copy(regions, n);
+    for (unsigned int r = 0 ; r < REPETITIONS ; ++r)
+    {
+        const uint64_t t0 = now();
+        copy(regions, n);
+        ns[r] = now() - t0;
+    }
+    qsort(ns.data(), REPETITIONS, sizeof(uint64_t), cmp);
+    return ns[REPETITIONS / 2];
+}
+
+static void
+print(const shape_t & s, const char * mode, unsigned int n, size_t bytes, uint64_t ns)
+{
+    printf("%6u %6u %6u %-8s %-7s %8u %14zu %12.2lf %10.2lf\n",
+            s.x, s.y, s.z, BACKEND_NAMES[BACKEND], mode, n, bytes, (double) ns / 1e3, (double) bytes / (double) ns);
+    fflush(stdout);
+}
+
+static void
+bench(const shape_t & s)
+{
+    const size_t width       = s.x * sizeof(float);
+    const size_t src_pitch   = width + PAD;
+    const size_t src_slice   = src_pitch * (s.y + PAD);
+    const size_t dst_pitch   = width;
+    const size_t dst_slice   = dst_pitch * s.y;
+    const size_t bytes       = width * s.y * s.z;
+
+    char * src = src_alloc(src_slice * s.z);
+    char * dst = dst_alloc(dst_slice * s.z);
+    memset(src, 1, src_slice * s.z);
+
+    // a single 3D region
+    strided_region_t box;
+    memset(&box, 0, sizeof(box));
+    box.dst             = dst;
+    box.src             = src;
+    box.dst_pitch       = dst_pitch;
+    box.dst_slice_pitch = dst_slice;
+    box.src_pitch       = src_pitch;
+    box.src_slice_pitch = src_slice;
+    box.width           = width;
+    box.height          = s.y;
+    box.depth           = s.z;
+    print(s, "box", 1, bytes, measure(&box, 1));
+
+    // a 2D region per slice
+    std::vector<strided_region_t> slices(s.z);
+    for (uint32_t z = 0 ; z < s.z ; ++z)
+        slices[z] = strided_region_2d(dst + z * dst_slice, src + z * src_slice, dst_pitch, src_pitch, width, s.y);
+    print(s, "slices", s.z, bytes, measure(slices.data(), s.z));
+
+    mem_free(dst);
+    mem_free(src);
+
+    // halo exchange of a periodic field
+    if (s.x < HALO || s.y < HALO || s.z < HALO)
+        return ;
+    strided_field_t field = strided_field(NULL, sizeof(float), s.x, s.y, s.z, HALO);
+    field.ptr = dst_alloc(strided_field_size(&field));
+    const strided_field_t * neighbours[STRIDED_FACE_MAX];
+    for (int face = 0 ; face < STRIDED_FACE_MAX ; ++face)
+        neighbours[face] = &field;
+    strided_region_t regions[STRIDED_FACE_MAX];
+    strided_halo_regions(&field, neighbours, regions);
+    size_t halo_bytes = 0;
+    for (const strided_region_t & r : regions)
+        halo_bytes += (size_t) r.width * r.height * r.depth;
+    print(s, "halo", STRIDED_FACE_MAX, halo_bytes, measure(regions, STRIDED_FACE_MAX));
+    mem_free(field.ptr);
+}
+
+int
+main(int argc, char ** argv)
+{
+    std::vector<shape_t> shapes = { { 4096, 4096, 1 }, { 512, 512, 1 }, { 256, 256, 256 }, { 64, 64, 64 }, { 1024, 1024, 8 } };
+    bool check = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:s:H:r:c")) != -1)
+    {
+        switch (opt)
+        {
+            case ('b'):
+            {
+                int b;
+                for (b = 0 ; b < BACKEND_MAX ; ++b)
+                    if (strcmp(optarg, BACKEND_NAMES[b]) == 0)
+                        break ;
+                if (b == BACKEND_MAX)
+                    LOGGER_FATAL("Unknown backend `%s`", optarg);
+                BACKEND = (backend_t) b;
+                break ;
+            }
+            case ('s'):
+            {
+                shapes.clear();
+                char * s = strdup(optarg);
+                for (char * tok = strtok(s, ",") ; tok ; tok = strtok(NULL, ","))
+                {
+                    shape_t shape = { 1, 1, 1 };
+                    if (sscanf(tok, "%ux%ux%u", &shape.x, &shape.y, &shape.z) < 1)
+                        LOGGER_FATAL("Invalid shape `%s`", tok);
+                    shapes.push_back(shape);
+                }
+                free(s);
+                break ;
+            }
+            case ('H'): HALO = atoi(optarg); break ;
+            case ('r'): REPETITIONS = atoi(optarg); break ;
+            case ('c'): check = true; break ;
+            default:
+                fprintf(stderr, "usage: %s [-b host|ze] [-s XxYxZ,...] [-H HALO] [-r REPS] [-c]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (REPETITIONS == 0)
+        REPETITIONS = 1;
+
+    LOGGER_INFO("Init");
+
+    if (BACKEND == BACKEND_ZE)
+    {
+        ze_device_init(&ZE);
+        if (ze_device_engines(&ZE, ZE_ENGINES_ALL, &ENGINE, 1) == 0)
+            LOGGER_FATAL("No copy engine");
+        const ze_event_pool_desc_t poolDesc = {
+            .stype  = ZE_STRUCTURE_TYPE_EVENT_POOL_DESC,
+            .pNext  = NULL,
+            .flags  = ZE_EVENT_POOL_FLAG_HOST_VISIBLE,
+            .count  = 1
+        };
+        ZE_SAFE_CALL(zeEventPoolCreate(ZE.context, &poolDesc, 1, &ZE.device, &POOL));
+        const ze_event_desc_t eventDesc = {
+            .stype  = ZE_STRUCTURE_TYPE_EVENT_DESC,
+            .pNext  = NULL,
+            .index  = 0,
+            .signal = ZE_EVENT_SCOPE_FLAG_HOST,
+            .wait   = ZE_EVENT_SCOPE_FLAG_HOST,
+        };
+        ZE_SAFE_CALL(zeEventCreate(POOL, &eventDesc, &DONE));
+    }
+
+    if (check)
+        self_check();
+    else
+    {
+        printf("%6s %6s %6s %-8s %-7s %8s %14s %12s %10s\n",
+                "x", "y", "z", "backend", "mode", "regions", "bytes", "median (us)", "GB/s");
+        for (const shape_t & s : shapes)
+            bench(s);
+    }
+
+    LOGGER_INFO("Deinit");
+
+    if (BACKEND == BACKEND_ZE)
+    {
+        ZE_SAFE_CALL(zeEventDestroy(DONE));
+        ZE_SAFE_CALL(zeEventPoolDestroy(POOL));
+        ze_device_engines_release(&ENGINE, 1);
+        ze_device_deinit(&ZE);
+    }
+
+    return 0;
+}
@@ -0,0 +1,293 @@
+/**
+ *  Scalability of concurrent copy submission from OpenMP threads.
+ *
+ *  'N' small tile copies (H2D, 'SX'x'SY' floats from a pitched host buffer)
+ *  are appended by 'T' threads, each appending its share of the tiles:
+ *      - own       each thread has its own immediate command list (on
+ *                  engine 'thread % ENGINES') and its own events
+ *      - shared    a single immediate command list, appended to under a
+ *                  lock, events still per thread
+ *  then each thread waits for the events of its tiles.
+ *
+ *  Threads are bound by the OpenMP runtime, as with omp-bind.cc (e.g.
+ *  'OMP_PROC_BIND=close OMP_PLACES=cores'); their cpu and node are logged
+ *  in debug. For each number of threads and mode, over 'REPS' rounds after
+ *  an untimed one, reports:
+ *      - the p50 / p99 / max latency of an append, over all appends
+ *      - the smallest and largest per-thread p50, to see whether some
+ *        threads are serialized behind the others
+ *      - the submission rate, in millions of appends per second, from the
+ *        first append of a round to the last one
+ *
+ *  usage: submit-bench [-t THREADS,...] [-n TILES] [-x SX] [-y SY] [-e ENGINES] [-m own|shared,...] [-r REPS]
+ */
+
+# include <getopt.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+# include <ze_api.h>
+
+# include <omp.h>
+
+# include <vector>
+
+# define LOGGER_HEADER "SUBMIT-BENCH"
+# include "logger-ze.h"
+# include "spinlock.h"
+# include "strided-copy.h"
+# include "ze-device.h"
+# include "ze-event-pool.h"
+# include "ze-numa.h"
+
+# define N_ENGINES_MAX 64
+
+typedef enum    list_mode_e
+{
+    LIST_OWN,
+    LIST_SHARED,
+    LIST_MAX
+}               list_mode_t;
+
+static const char * LIST_NAMES[LIST_MAX] = {
+    "own",
+    "shared"
+};
+
+static unsigned int REPETITIONS = 10;
+
+static inline uint64_t
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static int
+cmp(const void * a, const void * b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+// parse a comma-separated list of counts
+static std::vector<uint32_t>
+parse_list(const char * arg)
+{
+    std::vector<uint32_t> values;
+    char * s = strdup(arg);
+    for (char * tok = strtok(s, ",") ; tok ; tok = strtok(NULL, ","))
+        values.push_back(atoi(tok));
+    free(s);
+    return values;
+}
+
+// what a thread appends and measures
+typedef struct  submitter_s
+{
+    ze_command_list_handle_t list;
+    std::vector<event_t *> events;      // one per tile of its share
+    std::vector<uint64_t> latencies;    // of every append, over the rounds
+    uint64_t first, last;               // first and last append of the round
+}               submitter_t;
+
+int
+main(int argc, char ** argv)
+{
+    std::vector<uint32_t> nthreads = { 1, 2, 4, 8, 16 };
+    std::vector<uint32_t> modes = { LIST_OWN, LIST_SHARED };
+    uint32_t ntiles = 4096;
+    uint32_t sx = 64;
+    uint32_t sy = 16;
+    unsigned int nengines = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:n:x:y:e:m:r:")) != -1)
+    {
+        switch (opt)
+        {
+            case ('t'): nthreads = parse_list(optarg); break ;
+            case ('n'): ntiles = atoi(optarg); break ;
+            case ('x'): sx = atoi(optarg); break ;
+            case ('y'): sy = atoi(optarg); break ;
+            case ('e'): nengines = atoi(optarg); break ;
+            case ('m'):
+            {
+                modes.clear();
+                char * s = strdup(optarg);
+                for (char * tok = strtok(s, ",") ; tok ; tok = strtok(NULL, ","))
+                {
+                    int m;
+                    for (m = 0 ; m < LIST_MAX ; ++m)
+                        if (strcmp(tok, LIST_NAMES[m]) == 0)
+                            break ;
+                    if (m == LIST_MAX)
+                        LOGGER_FATAL("Unknown mode `%s`", tok);
+                    modes.push_back(m);
+                }
+                free(s);
+                break ;
+            }
+            case ('r'): REPETITIONS = atoi(optarg); break ;
+            default:
+                fprintf(stderr, "usage: %s [-t THREADS,...] [-n TILES] [-x SX] [-y SY] [-e ENGINES] [-m own|shared,...] [-r REPS]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (REPETITIONS == 0)
+        REPETITIONS = 1;
+
+    LOGGER_INFO("Init");
+
+    ze_device_t ze;
+    ze_device_init(&ze);
+
+    ze_engine_t engines[N_ENGINES_MAX];
+    const unsigned int n = ze_device_engines(&ze, ZE_ENGINES_ALL, engines, N_ENGINES_MAX);
+    if (n == 0)
+        LOGGER_FATAL("No copy engine");
+    if (nengines == 0 || nengines > n)
+        nengines = n;
+    LOGGER_INFO("Using %u engines, up to %d OpenMP threads", nengines, omp_get_max_threads());
+
+    // rounds rely on exactly 't' threads, one per submitter
+    omp_set_dynamic(0);
+
+    event_allocator_t events;
+    event_allocator_init(&events, ze.context, ze.device, ntiles, false);
+
+    // host tiles side by side, device tiles one after the other
+    const uint32_t width = sx * sizeof(float);
+    const size_t pitch = (size_t) ntiles * width;
+    char * hst_mem = (char *) malloc(pitch * sy);
+    if (hst_mem == NULL)
+        LOGGER_FATAL("Cannot allocate host memory");
+    memset(hst_mem, 1, pitch * sy);
+    const ze_device_mem_alloc_desc_t deviceDesc = {
+        .stype   = ZE_STRUCTURE_TYPE_DEVICE_MEM_ALLOC_DESC,
+        .pNext   = NULL,
+        .flags   = 0,
+        .ordinal = 0,
+    };
+    char * dev_mem;
+    ZE_SAFE_CALL(zeMemAllocDevice(ze.context, &deviceDesc, pitch * sy, 64, ze.device, (void **) &dev_mem));
+
+    spinlock_tas_t lock;
+    printf("%8s %-7s %8s %10s %10s %10s %14s %14s %14s\n", "threads", "mode", "appends",
+            "p50 (ns)", "p99 (ns)", "max (ns)", "min p50 (ns)", "max p50 (ns)", "rate (M/s)");
+    for (uint32_t t : nthreads)
+    {
+        if (t == 0)
+            continue ;
+
+        for (uint32_t mode : modes)
+        {
+            // lists and events, before any round
+            std::vector<submitter_t> submitters(t);
+            for (unsigned int k = 0 ; k < t ; ++k)
+            {
+                submitter_t & s = submitters[k];
+                const ze_engine_t & engine = engines[k % nengines];
+                s.list = mode == LIST_OWN ? ze_device_immediate_list(&ze, engine.ordinal, engine.index) : engines[0].list;
+                const unsigned int share = ntiles / t + (k < ntiles % t);
+                for (unsigned int i = 0 ; i < share ; ++i)
+                    s.events.push_back(event_alloc(&events));
+                s.latencies.reserve((size_t) share * REPETITIONS);
+            }
+
+            std::vector<uint64_t> rates(REPETITIONS);
+            for (int r = -1 ; r < (int) REPETITIONS ; ++r)
+            {
+                # pragma omp parallel num_threads(t)
+                {
+                    const int nt = omp_get_num_threads();
+                    if (nt != (int) t)
+                        LOGGER_FATAL("Got %d OpenMP threads instead of %d (see OMP_THREAD_LIMIT)", nt, (int) submitters.size());
+                    const unsigned int k = omp_get_thread_num();
+                    submitter_t & s = submitters[k];
+                    if (r == -1)
+                        numa_where("submit");
+
+                    // tiles k, k + t, k + 2t, ...
+                    # pragma omp barrier
+                    s.first = now();
+                    for (unsigned int j = 0 ; j < s.events.size() ; ++j)
+                    {
+                        const unsigned int i = k + j * t;
+                        const strided_region_t region = strided_region_2d(
+                                dev_mem + (size_t) i * width * sy, hst_mem + (size_t) i * width, width, pitch, width, sy);
+                        const uint64_t t0 = now();
+                        if (mode == LIST_SHARED)
+                        {
+                            spinlock_guard<spinlock_tas_t> guard(lock);
+                            strided_copy_ze_region(s.list, &region, s.events[j]->event, 0, NULL);
+                        }
+                        else
+                            strided_copy_ze_region(s.list, &region, s.events[j]->event, 0, NULL);
+                        const uint64_t t1 = now();
+                        if (r >= 0)
+                            s.latencies.push_back(t1 - t0);
+                    }
+                    s.last = now();
+
+                    for (event_t * e : s.events)
+                    {
+                        ZE_SAFE_CALL(zeEventHostSynchronize(e->event, UINT64_MAX));
+                        ZE_SAFE_CALL(zeEventHostReset(e->event));
+                    }
+                }
+
+                uint64_t first = UINT64_MAX, last = 0;
+                for (const submitter_t & s : submitters)
+                {
+                    first = s.first < first ? s.first : first;
+                    last  = s.last  > last  ? s.last  : last;
+                }
+                if (r >= 0)
+                    rates[r] = last - first;
+            }
+
+            // per thread, then over all threads
+            std::vector<uint64_t> all;
+            uint64_t min_p50 = UINT64_MAX, max_p50 = 0;
+            for (submitter_t & s : submitters)
+            {
+                if (s.latencies.empty())
+                    continue ;
+                qsort(s.latencies.data(), s.latencies.size(), sizeof(uint64_t), cmp);
+                const uint64_t p50 = s.latencies[s.latencies.size() / 2];
+                min_p50 = p50 < min_p50 ? p50 : min_p50;
+                max_p50 = p50 > max_p50 ? p50 : max_p50;
+                all.insert(all.end(), s.latencies.begin(), s.latencies.end());
+            }
+            qsort(all.data(), all.size(), sizeof(uint64_t), cmp);
+            qsort(rates.data(), REPETITIONS, sizeof(uint64_t), cmp);
+
+            printf("%8u %-7s %8u %10lu %10lu %10lu %14lu %14lu %14.3lf\n",
+                    t, LIST_NAMES[mode], ntiles,
+                    all[all.size() / 2], all[(all.size() * 99) / 100], all.back(), min_p50, max_p50,
+                    (double) ntiles * 1e3 / (double) rates[REPETITIONS / 2]);
+            fflush(stdout);
+
+            for (submitter_t & s : submitters)
+            {
+                for (event_t * e : s.events)
+                    event_free(&events, e);
+                if (mode == LIST_OWN)
+                    ZE_SAFE_CALL(zeCommandListDestroy(s.list));
+            }
+        }
+    }
+
+    LOGGER_INFO("Deinit");
+
+    ZE_SAFE_CALL(zeMemFree(ze.context, dev_mem));
+    free(hst_mem);
+    event_allocator_deinit(&events);
+    ze_device_engines_release(engines, n);
+    ze_device_deinit(&ze);
+
+    return 0;
+}
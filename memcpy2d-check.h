@@ -0,0 +1,190 @@
+#ifndef __MEMCPY2D_CHECK_H__
+# define __MEMCPY2D_CHECK_H__
+
+/**
+ *  Initialization and verification kernels of the memcpy2d benchmarks,
+ *  split among the OpenMP threads and vectorized:
+ *      - memcpy2d_fill<T>(mem, n)              mem[i] = (T) i
+ *      - memcpy2d_zero(mem, n)                 memset(mem, 0, n)
+ *      - memcpy2d_verify<T>(mem, offset, n)    first byte of [mem, mem + n)
+ *                          that differs from the 'memcpy2d_fill<T>' pattern,
+ *                          'mem' being at the byte 'offset' of the pattern
+ *                          (-1 if none)
+ *      - memcpy2d_crc32c(crc, mem, n)          CRC32C of [mem, mem + n),
+ *                          with the SSE 4.2 'crc32' instruction if the cpu
+ *                          has it ('MEMCPY2D_CRC32C=generic' to force the
+ *                          table-driven one)
+ *
+ *  Verifying against the pattern reads the buffer once, and tells where it
+ *  differs; checksums can verify data whose content cannot be regenerated,
+ *  from one CRC32C per tile computed before the transfers.
+ */
+
+# include <stdint.h>
+# include <stdlib.h>
+# include <string.h>
+# include <sys/types.h>
+
+# ifdef _OPENMP
+#  include <omp.h>
+# endif
+
+# if defined(__x86_64__) || defined(__i386__)
+#  include <immintrin.h>
+#  define MEMCPY2D_CHECK_X86 1
+# else
+#  define MEMCPY2D_CHECK_X86 0
+# endif
+
+// bytes per thread chunk of the fill and zero kernels
+# ifndef MEMCPY2D_CHECK_CHUNK
+#  define MEMCPY2D_CHECK_CHUNK (256 * 1024)
+# endif
+
+template <typename T>
+static void
+memcpy2d_fill(void * mem, size_t n)
+{
+    T * t = (T *) mem;
+    # ifdef _OPENMP
+    #  pragma omp parallel for simd schedule(static)
+    # endif
+    for (size_t i = 0 ; i < n ; ++i)
+        t[i] = (T) i;
+}
+
+static inline void
+memcpy2d_zero(void * mem, size_t n)
+{
+    const size_t nchunks = (n + MEMCPY2D_CHECK_CHUNK - 1) / MEMCPY2D_CHECK_CHUNK;
+    # ifdef _OPENMP
+    #  pragma omp parallel for schedule(static)
+    # endif
+    for (size_t c = 0 ; c < nchunks ; ++c)
+    {
+        const size_t off = c * MEMCPY2D_CHECK_CHUNK;
+        memset((char *) mem + off, 0, off + MEMCPY2D_CHECK_CHUNK <= n ? MEMCPY2D_CHECK_CHUNK : n - off);
+    }
+}
+
+// the byte 'b' of the 'memcpy2d_fill<T>' pattern
+template <typename T>
+static inline unsigned char
+memcpy2d_pattern_byte(size_t b)
+{
+    const T v = (T) (b / sizeof(T));
+    return ((const unsigned char *) &v)[b % sizeof(T)];
+}
+
+template <typename T>
+static ssize_t
+memcpy2d_verify(const void * mem, size_t offset, size_t n)
+{
+    const unsigned char * p = (const unsigned char *) mem;
+
+    // unaligned head, whole elements, tail
+    size_t head = (sizeof(T) - offset % sizeof(T)) % sizeof(T);
+    if (head > n)
+        head = n;
+    const size_t nelems = (n - head) / sizeof(T);
+    const size_t tail   = head + nelems * sizeof(T);
+
+    for (size_t b = 0 ; b < head ; ++b)
+        if (p[b] != memcpy2d_pattern_byte<T>(offset + b))
+            return b;
+
+    const T * t = (const T *) (p + head);
+    const size_t first = (offset + head) / sizeof(T);
+    size_t bad = nelems;
+    # ifdef _OPENMP
+    #  pragma omp simd reduction(min:bad)
+    # endif
+    for (size_t i = 0 ; i < nelems ; ++i)
+        if (t[i] != (T) (first + i) && i < bad)
+            bad = i;
+    if (bad < nelems)
+    {
+        // the first differing byte of the element
+        for (size_t b = head + bad * sizeof(T) ; ; ++b)
+            if (p[b] != memcpy2d_pattern_byte<T>(offset + b))
+                return b;
+    }
+
+    for (size_t b = tail ; b < n ; ++b)
+        if (p[b] != memcpy2d_pattern_byte<T>(offset + b))
+            return b;
+
+    return -1;
+}
+
+// the CRC32C (reflected polynomial 0x82F63B78) of each byte
+static inline const uint32_t *
+memcpy2d_crc32c_table(void)
+{
+    static uint32_t table[256];
+    for (uint32_t i = 0 ; i < 256 ; ++i)
+    {
+        uint32_t c = i;
+        for (int k = 0 ; k < 8 ; ++k)
+            c = (c >> 1) ^ (0x82F63B78 & (0 - (c & 1)));
+        table[i] = c;
+    }
+    return table;
+}
+
+static inline uint32_t
+memcpy2d_crc32c_generic(uint32_t crc, const void * mem, size_t n)
+{
+    static const uint32_t * table = memcpy2d_crc32c_table();
+
+    const unsigned char * p = (const unsigned char *) mem;
+    crc = ~crc;
+    for (size_t i = 0 ; i < n ; ++i)
+        crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+# if MEMCPY2D_CHECK_X86
+__attribute__((target("sse4.2")))
+static inline uint32_t
+memcpy2d_crc32c_sse42(uint32_t crc, const void * mem, size_t n)
+{
+    const unsigned char * p = (const unsigned char *) mem;
+    uint64_t c = (uint32_t) ~crc;
+    size_t i = 0;
+    for ( ; i + 8 <= n ; i += 8)
+    {
+        uint64_t v;
+        memcpy(&v, p + i, 8);
+        c = _mm_crc32_u64(c, v);
+    }
+    uint32_t c32 = (uint32_t) c;
+    for ( ; i < n ; ++i)
+        c32 = _mm_crc32_u8(c32, p[i]);
+    return ~c32;
+}
+# endif /* MEMCPY2D_CHECK_X86 */
+
+typedef uint32_t (*memcpy2d_crc32c_t)(uint32_t crc, const void * mem, size_t n);
+
+static inline memcpy2d_crc32c_t
+memcpy2d_crc32c_kernel(void)
+{
+    const char * env = getenv("MEMCPY2D_CRC32C");
+    if (env && strcmp(env, "generic") == 0)
+        return memcpy2d_crc32c_generic;
+# if MEMCPY2D_CHECK_X86
+    if (__builtin_cpu_supports("sse4.2"))
+        return memcpy2d_crc32c_sse42;
+# endif /* MEMCPY2D_CHECK_X86 */
+    return memcpy2d_crc32c_generic;
+}
+
+static inline uint32_t
+memcpy2d_crc32c(uint32_t crc, const void * mem, size_t n)
+{
+    static const memcpy2d_crc32c_t kernel = memcpy2d_crc32c_kernel();
+    return kernel(crc, mem, n);
+}
+
+#endif /* __MEMCPY2D_CHECK_H__ */
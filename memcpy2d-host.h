@@ -0,0 +1,314 @@
+#ifndef __MEMCPY2D_HOST_H__
+# define __MEMCPY2D_HOST_H__
+
+/**
+ *  Host implementation of the pitched 2D region copy of 'main-memcpy2d.cc',
+ *  with the same parameters as 'zeCommandListAppendMemoryCopyRegion':
+ *  copies 'height' rows of 'width' bytes, the row 'y' starting at
+ *  'src + y * src_pitch + src_ox' to 'dst + y * dst_pitch + dst_ox'.
+ *
+ *      memcpy2d_host(dst, src, dst_pitch, src_pitch, width, height, dst_ox, src_ox);
+ *
+ *  Rows are copied by an SIMD kernel, picked at the first call from the
+ *  best instruction set of the running cpu ('MEMCPY2D_HOST_ISA=generic|avx2|avx512'
+ *  to force one):
+ *      - generic   'memcpy' per row
+ *      - avx2      32 bytes loads/stores
+ *      - avx512    64 bytes loads/stores
+ *
+ *  Regions of at least 'MEMCPY2D_HOST_NT_THRESHOLD' bytes use non-temporal
+ *  stores, so that a copy larger than the caches does not evict them (and
+ *  does not read the destination lines before writing them).
+ *
+ *  Regions of at least 'MEMCPY2D_HOST_OMP_THRESHOLD' bytes are split among
+ *  the OpenMP threads: by rows, or by chunks of 'MEMCPY2D_HOST_CHUNK' bytes
+ *  of each row if there are less rows than threads.
+ *
+ *  'memcpy2d_host_ex' exposes each of these choices, for benchmarking.
+ */
+
+# include <stdint.h>
+# include <stdlib.h>
+# include <string.h>
+# include <strings.h>
+
+# ifdef _OPENMP
+#  include <omp.h>
+# endif
+
+# if defined(__x86_64__) || defined(__i386__)
+#  include <immintrin.h>
+#  define MEMCPY2D_HOST_X86 1
+# else
+#  define MEMCPY2D_HOST_X86 0
+# endif
+
+// bytes copied from which stores are non-temporal
+# ifndef MEMCPY2D_HOST_NT_THRESHOLD
+#  define MEMCPY2D_HOST_NT_THRESHOLD (4 * 1024 * 1024)
+# endif
+
+// bytes copied from which the copy is split among threads
+# ifndef MEMCPY2D_HOST_OMP_THRESHOLD
+#  define MEMCPY2D_HOST_OMP_THRESHOLD (1 * 1024 * 1024)
+# endif
+
+// size of the chunks a row is split into, multiple of the 64 bytes vectors
+# ifndef MEMCPY2D_HOST_CHUNK
+#  define MEMCPY2D_HOST_CHUNK (64 * 1024)
+# endif
+
+typedef enum    memcpy2d_host_isa_e
+{
+    MEMCPY2D_HOST_ISA_GENERIC,
+    MEMCPY2D_HOST_ISA_AVX2,
+    MEMCPY2D_HOST_ISA_AVX512,
+    MEMCPY2D_HOST_ISA_MAX
+}               memcpy2d_host_isa_t;
+
+static const char * MEMCPY2D_HOST_ISA_NAMES[MEMCPY2D_HOST_ISA_MAX] __attribute__((unused)) = {
+    "generic",
+    "avx2",
+    "avx512"
+};
+
+// copy one row of 'n' bytes
+typedef void (*memcpy2d_host_row_t)(char * dst, const char * src, size_t n);
+
+static inline void
+memcpy2d_host_row_generic(char * dst, const char * src, size_t n)
+{
+    memcpy(dst, src, n);
+}
+
+static inline void
+memcpy2d_host_row_generic_nt(char * dst, const char * src, size_t n)
+{
+    // no portable streaming store
+    memcpy(dst, src, n);
+}
+
+# if MEMCPY2D_HOST_X86
+
+__attribute__((target("avx2")))
+static void
+memcpy2d_host_row_avx2(char * dst, const char * src, size_t n)
+{
+    size_t i = 0;
+    for ( ; i + 128 <= n ; i += 128)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (src + i +  0));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (src + i + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i *) (src + i + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i *) (src + i + 96));
+        _mm256_storeu_si256((__m256i *) (dst + i +  0), a);
+        _mm256_storeu_si256((__m256i *) (dst + i + 32), b);
+        _mm256_storeu_si256((__m256i *) (dst + i + 64), c);
+        _mm256_storeu_si256((__m256i *) (dst + i + 96), d);
+    }
+    for ( ; i + 32 <= n ; i += 32)
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_loadu_si256((const __m256i *) (src + i)));
+    if (i < n)
+        memcpy(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void
+memcpy2d_host_row_avx2_nt(char * dst, const char * src, size_t n)
+{
+    // streaming stores need an aligned destination: copy the head first
+    size_t i = (32 - ((uintptr_t) dst & 31)) & 31;
+    if (i > n)
+        i = n;
+    if (i)
+        memcpy(dst, src, i);
+    for ( ; i + 128 <= n ; i += 128)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (src + i +  0));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (src + i + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i *) (src + i + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i *) (src + i + 96));
+        _mm256_stream_si256((__m256i *) (dst + i +  0), a);
+        _mm256_stream_si256((__m256i *) (dst + i + 32), b);
+        _mm256_stream_si256((__m256i *) (dst + i + 64), c);
+        _mm256_stream_si256((__m256i *) (dst + i + 96), d);
+    }
+    for ( ; i + 32 <= n ; i += 32)
+        _mm256_stream_si256((__m256i *) (dst + i), _mm256_loadu_si256((const __m256i *) (src + i)));
+    if (i < n)
+        memcpy(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void
+memcpy2d_host_row_avx512(char * dst, const char * src, size_t n)
+{
+    size_t i = 0;
+    for ( ; i + 256 <= n ; i += 256)
+    {
+        __m512i a = _mm512_loadu_si512((const void *) (src + i +   0));
+        __m512i b = _mm512_loadu_si512((const void *) (src + i +  64));
+        __m512i c = _mm512_loadu_si512((const void *) (src + i + 128));
+        __m512i d = _mm512_loadu_si512((const void *) (src + i + 192));
+        _mm512_storeu_si512((void *) (dst + i +   0), a);
+        _mm512_storeu_si512((void *) (dst + i +  64), b);
+        _mm512_storeu_si512((void *) (dst + i + 128), c);
+        _mm512_storeu_si512((void *) (dst + i + 192), d);
+    }
+    for ( ; i + 64 <= n ; i += 64)
+        _mm512_storeu_si512((void *) (dst + i), _mm512_loadu_si512((const void *) (src + i)));
+    if (i < n)
+        memcpy(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void
+memcpy2d_host_row_avx512_nt(char * dst, const char * src, size_t n)
+{
+    // streaming stores need an aligned destination: copy the head first
+    size_t i = (64 - ((uintptr_t) dst & 63)) & 63;
+    if (i > n)
+        i = n;
+    if (i)
+        memcpy(dst, src, i);
+    for ( ; i + 256 <= n ; i += 256)
+    {
+        __m512i a = _mm512_loadu_si512((const void *) (src + i +   0));
+        __m512i b = _mm512_loadu_si512((const void *) (src + i +  64));
+        __m512i c = _mm512_loadu_si512((const void *) (src + i + 128));
+        __m512i d = _mm512_loadu_si512((const void *) (src + i + 192));
+        _mm512_stream_si512((__m512i *) (dst + i +   0), a);
+        _mm512_stream_si512((__m512i *) (dst + i +  64), b);
+        _mm512_stream_si512((__m512i *) (dst + i + 128), c);
+        _mm512_stream_si512((__m512i *) (dst + i + 192), d);
+    }
+    for ( ; i + 64 <= n ; i += 64)
+        _mm512_stream_si512((__m512i *) (dst + i), _mm512_loadu_si512((const void *) (src + i)));
+    if (i < n)
+        memcpy(dst + i, src + i, n - i);
+}
+
+# endif /* MEMCPY2D_HOST_X86 */
+
+// returns 1 if the running cpu supports 'isa'
+static inline int
+memcpy2d_host_isa_supported(memcpy2d_host_isa_t isa)
+{
+    switch (isa)
+    {
+        case (MEMCPY2D_HOST_ISA_GENERIC):
+            return 1;
+        # if MEMCPY2D_HOST_X86
+        case (MEMCPY2D_HOST_ISA_AVX2):
+            return __builtin_cpu_supports("avx2");
+        case (MEMCPY2D_HOST_ISA_AVX512):
+            return __builtin_cpu_supports("avx512f");
+        # endif
+        default:
+            return 0;
+    }
+}
+
+// best supported instruction set, or the one of '$MEMCPY2D_HOST_ISA'
+static inline memcpy2d_host_isa_t
+memcpy2d_host_isa_resolve(void)
+{
+    const char * env = getenv("MEMCPY2D_HOST_ISA");
+    if (env)
+        for (int isa = 0 ; isa < MEMCPY2D_HOST_ISA_MAX ; ++isa)
+            if (strcasecmp(env, MEMCPY2D_HOST_ISA_NAMES[isa]) == 0 && memcpy2d_host_isa_supported((memcpy2d_host_isa_t) isa))
+                return (memcpy2d_host_isa_t) isa;
+
+    for (int isa = MEMCPY2D_HOST_ISA_MAX - 1 ; isa > 0 ; --isa)
+        if (memcpy2d_host_isa_supported((memcpy2d_host_isa_t) isa))
+            return (memcpy2d_host_isa_t) isa;
+    return MEMCPY2D_HOST_ISA_GENERIC;
+}
+
+// instruction set used by 'memcpy2d_host', resolved once
+static inline memcpy2d_host_isa_t
+memcpy2d_host_isa(void)
+{
+    static const memcpy2d_host_isa_t isa = memcpy2d_host_isa_resolve();
+    return isa;
+}
+
+static inline memcpy2d_host_row_t
+memcpy2d_host_kernel(memcpy2d_host_isa_t isa, int nt)
+{
+    switch (isa)
+    {
+        # if MEMCPY2D_HOST_X86
+        case (MEMCPY2D_HOST_ISA_AVX2):
+            return nt ? memcpy2d_host_row_avx2_nt   : memcpy2d_host_row_avx2;
+        case (MEMCPY2D_HOST_ISA_AVX512):
+            return nt ? memcpy2d_host_row_avx512_nt : memcpy2d_host_row_avx512;
+        # endif
+        default:
+            return nt ? memcpy2d_host_row_generic_nt : memcpy2d_host_row_generic;
+    }
+}
+
+/**
+ *  Copy with the given instruction set, non-temporal stores or not, and
+ *  number of threads (if '<= 1', the calling thread copies everything).
+ */
+static inline void
+memcpy2d_host_ex(
+    memcpy2d_host_isa_t isa, int nt, int nthreads,
+    void * dst, const void * src,
+    const size_t dst_pitch, const size_t src_pitch,
+    uint32_t width, uint32_t height,
+    uint32_t dst_ox, uint32_t src_ox
+) {
+    const memcpy2d_host_row_t row = memcpy2d_host_kernel(isa, nt);
+          char * d = (      char *) dst + dst_ox;
+    const char * s = (const char *) src + src_ox;
+
+    // rows are split in chunks only if there is not enough rows for each thread
+    const size_t nchunks = (nthreads > 1 && height < (uint32_t) nthreads) ? (width + MEMCPY2D_HOST_CHUNK - 1) / MEMCPY2D_HOST_CHUNK : 1;
+    const size_t chunk = nchunks > 1 ? MEMCPY2D_HOST_CHUNK : width;
+    const int64_t nitems = (int64_t) height * (int64_t) nchunks;
+
+    # ifdef _OPENMP
+    #  pragma omp parallel num_threads(nthreads) if(nthreads > 1)
+    # endif
+    {
+        # ifdef _OPENMP
+        #  pragma omp for schedule(static) nowait
+        # endif
+        for (int64_t item = 0 ; item < nitems ; ++item)
+        {
+            const size_t y   = (size_t) (item / nchunks);
+            const size_t off = (size_t) (item % nchunks) * chunk;
+            const size_t n   = (off + chunk <= width) ? chunk : width - off;
+            row(d + y * dst_pitch + off, s + y * src_pitch + off, n);
+        }
+
+        // streaming stores are weakly ordered: make them visible before returning
+        # if MEMCPY2D_HOST_X86
+        if (nt)
+            _mm_sfence();
+        # endif
+    }
+}
+
+// copy with the best instruction set, and sizes thresholds
+static inline void
+memcpy2d_host(
+    void * dst, const void * src,
+    const size_t dst_pitch, const size_t src_pitch,
+    uint32_t width, uint32_t height,
+    uint32_t dst_ox, uint32_t src_ox
+) {
+    const size_t size = (size_t) width * (size_t) height;
+    const int nt = size >= MEMCPY2D_HOST_NT_THRESHOLD;
+    # ifdef _OPENMP
+    const int nthreads = size >= MEMCPY2D_HOST_OMP_THRESHOLD ? omp_get_max_threads() : 1;
+    # else
+    const int nthreads = 1;
+    # endif
+    memcpy2d_host_ex(memcpy2d_host_isa(), nt, nthreads, dst, src, dst_pitch, src_pitch, width, height, dst_ox, src_ox);
+}
+
+#endif /* __MEMCPY2D_HOST_H__ */
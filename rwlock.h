@@ -0,0 +1,78 @@
+#ifndef __RWLOCK_H__
+# define __RWLOCK_H__
+
+# include <stdint.h>
+
+# include "mem.h"
+# include "spinlock.h"
+
+/**
+ *  Reader-writer spinlocks: 'state' is '-1' if a writer holds the lock, or
+ *  the number of readers holding it.
+ *      - rwlock_reader_pref_t  readers enter as long as no writer holds the
+ *                              lock: writers may starve under a continuous
+ *                              flow of readers
+ *      - rwlock_writer_pref_t  readers do not enter while a writer is
+ *                              waiting: readers may starve under a continuous
+ *                              flow of writers
+ */
+template <bool WRITER_PREF>
+class rwlock_base_t
+{
+    public:
+        void
+        read_lock(void)
+        {
+            while (1)
+            {
+                if (WRITER_PREF)
+                    while (this->writers)
+                        mem_pause();
+                const int32_t state = this->state;
+                if (state >= 0 && __sync_bool_compare_and_swap(&this->state, state, state + 1))
+                    break ;
+                mem_pause();
+            }
+            readmem_barrier();
+        }
+
+        void
+        read_unlock(void)
+        {
+            __sync_fetch_and_sub(&this->state, 1);
+        }
+
+        void
+        write_lock(void)
+        {
+            if (WRITER_PREF)
+                __sync_fetch_and_add(&this->writers, 1);
+            while (1)
+            {
+                if (this->state == 0 && __sync_bool_compare_and_swap(&this->state, 0, -1))
+                    break ;
+                mem_pause();
+            }
+            if (WRITER_PREF)
+                __sync_fetch_and_sub(&this->writers, 1);
+            readmem_barrier();
+        }
+
+        void
+        write_unlock(void)
+        {
+            mem_barrier();
+            this->state = 0;
+        }
+
+    private:
+        alignas(SPINLOCK_CACHE_LINE_SIZE) volatile int32_t state = 0;
+
+        /* number of writers waiting (writer-preferring only) */
+        alignas(SPINLOCK_CACHE_LINE_SIZE) volatile int32_t writers = 0;
+};
+
+typedef rwlock_base_t<false>    rwlock_reader_pref_t;
+typedef rwlock_base_t<true>     rwlock_writer_pref_t;
+
+#endif /* __RWLOCK_H__ */
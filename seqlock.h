@@ -0,0 +1,65 @@
+#ifndef __SEQLOCK_H__
+# define __SEQLOCK_H__
+
+# include <stdint.h>
+
+# include "mem.h"
+# include "spinlock.h"
+
+/**
+ *  Sequence lock, for read-mostly data: readers never write shared memory,
+ *  so they do not serialize on a cache line, but retry if a writer ran
+ *  concurrently. Writers serialize on a spinlock.
+ *
+ *      uint32_t seq;
+ *      do {
+ *          seq = sl.read_begin();
+ *          ... copy the protected data ...
+ *      } while (sl.read_retry(seq));
+ *
+ *  The copy may be torn while a writer runs: readers must only use the
+ *  copied values once 'read_retry' returned 'false', and the protected data
+ *  should be read through 'volatile' accesses.
+ */
+class seqlock_t
+{
+    public:
+        uint32_t
+        read_begin(void) const
+        {
+            uint32_t seq;
+            while ((seq = this->seq) & 1)
+                mem_pause();
+            readmem_barrier();
+            return seq;
+        }
+
+        bool
+        read_retry(uint32_t seq) const
+        {
+            readmem_barrier();
+            return this->seq != seq;
+        }
+
+        void
+        write_lock(void)
+        {
+            SPINLOCK_LOCK(this->lock);
+            this->seq = this->seq + 1;
+            writemem_barrier();
+        }
+
+        void
+        write_unlock(void)
+        {
+            writemem_barrier();
+            this->seq = this->seq + 1;
+            SPINLOCK_UNLOCK(this->lock);
+        }
+
+    private:
+        alignas(SPINLOCK_CACHE_LINE_SIZE) volatile uint32_t seq = 0;
+        spinlock_t lock = SPINLOCK_INITIALIZER;
+};
+
+#endif /* __SEQLOCK_H__ */
@@ -16,32 +16,664 @@
 
 # include "mem.h"
 
-#if 1
+/**
+ *  Lock family, sharing a common interface so that they can be swapped in
+ *  templated code:
+ *      - 'node_t'          per-acquisition state, owned by the locking
+ *                          thread until the unlock (empty for non-queued locks)
+ *      - 'lock(node_t &)'
+ *      - 'unlock(node_t &)'
+ *      - 'trylock(node_t &)' for node-less locks, returns 'true' on success
+ *  And 'spinlock_guard<L>' to acquire a lock for the duration of a scope.
+ *
+ *      - spinlock_tas_t    test-and-set, same as 'SPINLOCK_LOCK'
+ *      - spinlock_ttas_t   test-and-test-and-set with exponential backoff
+ *      - spinlock_ticket_t FIFO ticket lock
+ *      - spinlock_mcs_t    MCS queue lock, each waiter spins on its own node
+ *      - spinlock_clh_t    CLH queue lock, each waiter spins on its
+ *                          predecessor node
+ *      - spinlock_mutex_t  pthread mutex, parks the waiters
+ *      - spinlock_futex_t  spins for a bounded budget, then parks on a futex
+ */
 
-typedef volatile int spinlock_t;
+# include <pthread.h>
+# include <sched.h>
+# include <stddef.h>
+# include <stdint.h>
+# include <string.h>
 
-# define SPINLOCK_LOCK(L)                                       \
-    do {                                                        \
-        int zero = 0;                                           \
-        while (__sync_val_compare_and_swap(&L, zero, 1) == 1)   \
-            mem_pause();                                        \
-    } while (0)
+# include <type_traits>
 
-# define SPINLOCK_UNLOCK(L)             \
-    do {                                \
-        __sync_fetch_and_xor(&L, L);    \
-    } while (0)
+# if defined(__linux__)
+#  include <linux/futex.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+# endif
 
-# define SPINLOCK_INITIALIZER 0
+# define SPINLOCK_CACHE_LINE_SIZE 64
+
+typedef struct {} spinlock_no_node_t;
+
+class spinlock_tas_t
+{
+    public:
+        typedef spinlock_no_node_t node_t;
+
+        void
+        lock(node_t &)
+        {
+            while (__sync_val_compare_and_swap(&this->flag, 0, 1) == 1)
+                mem_pause();
+        }
+
+        bool
+        trylock(node_t &)
+        {
+            return __sync_val_compare_and_swap(&this->flag, 0, 1) == 0;
+        }
+
+        void
+        unlock(node_t &)
+        {
+            __sync_lock_release(&this->flag);
+        }
+
+    private:
+        alignas(SPINLOCK_CACHE_LINE_SIZE) volatile int flag = 0;
+};
+
+template <unsigned int BACKOFF_MIN = 4, unsigned int BACKOFF_MAX = 1024>
+class spinlock_ttas_backoff_t
+{
+    public:
+        typedef spinlock_no_node_t node_t;
+
+        void
+        lock(node_t &)
+        {
+            unsigned int backoff = BACKOFF_MIN;
+            while (1)
+            {
+                // spin on a shared copy of the line until it looks free
+                while (this->flag)
+                    mem_pause();
+                if (__sync_lock_test_and_set(&this->flag, 1) == 0)
+                    return ;
+                for (unsigned int i = 0 ; i < backoff ; ++i)
+                    mem_pause();
+                if (backoff < BACKOFF_MAX)
+                    backoff *= 2;
+            }
+        }
+
+        bool
+        trylock(node_t &)
+        {
+            return this->flag == 0 && __sync_lock_test_and_set(&this->flag, 1) == 0;
+        }
+
+        void
+        unlock(node_t &)
+        {
+            __sync_lock_release(&this->flag);
+        }
+
+    private:
+        alignas(SPINLOCK_CACHE_LINE_SIZE) volatile int flag = 0;
+};
+
+typedef spinlock_ttas_backoff_t<> spinlock_ttas_t;
+
+class spinlock_ticket_t
+{
+    public:
+        typedef spinlock_no_node_t node_t;
+
+        void
+        lock(node_t &)
+        {
+            const uint32_t ticket = __sync_fetch_and_add(&this->next, 1);
+            while (1)
+            {
+                const uint32_t owner = this->owner;
+                if (owner == ticket)
+                    break ;
+                // proportional backoff: wait longer the further in the queue
+                for (uint32_t i = 0 ; i < ticket - owner ; ++i)
+                    mem_pause();
+            }
+            readmem_barrier();
+        }
+
+        bool
+        trylock(node_t &)
+        {
+            // only take a ticket if it is served right away
+            const uint32_t owner = this->owner;
+            return __sync_bool_compare_and_swap(&this->next, owner, owner + 1);
+        }
+
+        void
+        unlock(node_t &)
+        {
+            mem_barrier();
+            this->owner = this->owner + 1;
+        }
+
+    private:
+        alignas(SPINLOCK_CACHE_LINE_SIZE) volatile uint32_t next  = 0;
+        alignas(SPINLOCK_CACHE_LINE_SIZE) volatile uint32_t owner = 0;
+};
+
+class spinlock_mcs_t
+{
+    public:
+        typedef struct  node_s
+        {
+            alignas(SPINLOCK_CACHE_LINE_SIZE) struct node_s * volatile next;
+            volatile int locked;
+        }               node_t;
+
+        void
+        lock(node_t & node)
+        {
+            node.next   = NULL;
+            node.locked = 1;
+            node_t * pred = __atomic_exchange_n(&this->tail, &node, __ATOMIC_ACQ_REL);
+            if (pred)
+            {
+                pred->next = &node;
+                while (node.locked)
+                    mem_pause();
+            }
+            readmem_barrier();
+        }
+
+        void
+        unlock(node_t & node)
+        {
+            if (node.next == NULL)
+            {
+                if (__sync_bool_compare_and_swap(&this->tail, &node, NULL))
+                    return ;
+                // a successor is enqueuing itself
+                while (node.next == NULL)
+                    mem_pause();
+            }
+            mem_barrier();
+            node.next->locked = 0;
+        }
+
+    private:
+        alignas(SPINLOCK_CACHE_LINE_SIZE) node_t * volatile tail = NULL;
+};
+
+typedef struct  spinlock_clh_qnode_s
+{
+    alignas(SPINLOCK_CACHE_LINE_SIZE) volatile int locked;
+    struct spinlock_clh_qnode_s * next_free;
+}               spinlock_clh_qnode_t;
+
+/**
+ *  CLH nodes outlive the acquisition (the successor spins on it after the
+ *  unlock), and on unlock, a thread takes ownership of its predecessor node.
+ *  Nodes are therefore recycled through a per-thread free list.
+ */
+class spinlock_clh_pool_t
+{
+    public:
+        ~spinlock_clh_pool_t()
+        {
+            while (this->head)
+            {
+                spinlock_clh_qnode_t * next = this->head->next_free;
+                delete this->head;
+                this->head = next;
+            }
+        }
+
+        spinlock_clh_qnode_t *
+        get(void)
+        {
+            spinlock_clh_qnode_t * node = this->head;
+            if (node)
+                this->head = node->next_free;
+            else
+                node = new spinlock_clh_qnode_t;
+            return node;
+        }
+
+        void
+        put(spinlock_clh_qnode_t * node)
+        {
+            node->next_free = this->head;
+            this->head = node;
+        }
+
+    private:
+        spinlock_clh_qnode_t * head = NULL;
+};
+
+inline thread_local spinlock_clh_pool_t SPINLOCK_CLH_POOL;
+
+class spinlock_clh_t
+{
+    public:
+        typedef struct
+        {
+            spinlock_clh_qnode_t * me;
+            spinlock_clh_qnode_t * pred;
+        }   node_t;
+
+        spinlock_clh_t()
+        {
+            this->tail = new spinlock_clh_qnode_t;
+            this->tail->locked = 0;
+        }
+
+        ~spinlock_clh_t()
+        {
+            delete this->tail;
+        }
+
+        spinlock_clh_t(const spinlock_clh_t &) = delete;
+        spinlock_clh_t & operator=(const spinlock_clh_t &) = delete;
+
+        void
+        lock(node_t & node)
+        {
+            node.me = SPINLOCK_CLH_POOL.get();
+            node.me->locked = 1;
+            node.pred = __atomic_exchange_n(&this->tail, node.me, __ATOMIC_ACQ_REL);
+            while (node.pred->locked)
+                mem_pause();
+            readmem_barrier();
+        }
+
+        void
+        unlock(node_t & node)
+        {
+            mem_barrier();
+            node.me->locked = 0;
+            SPINLOCK_CLH_POOL.put(node.pred);
+        }
+
+    private:
+        alignas(SPINLOCK_CACHE_LINE_SIZE) spinlock_clh_qnode_t * volatile tail;
+};
+
+class spinlock_mutex_t
+{
+    public:
+        typedef spinlock_no_node_t node_t;
+
+        void
+        lock(node_t &)
+        {
+            pthread_mutex_lock(&this->mutex);
+        }
+
+        bool
+        trylock(node_t &)
+        {
+            return pthread_mutex_trylock(&this->mutex) == 0;
+        }
+
+        void
+        unlock(node_t &)
+        {
+            pthread_mutex_unlock(&this->mutex);
+        }
+
+    private:
+        pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+};
+
+/* default spin budget of a 'spinlock_futex_t', in 'pause' */
+# ifndef SPINLOCK_FUTEX_SPIN
+#  define SPINLOCK_FUTEX_SPIN 1024
+# endif
+
+/**
+ *  Adaptive lock: spins for 'spin' iterations, then parks on a futex
+ *  (Drepper, "Futexes Are Tricky", mutex #3).
+ *  The state is '0' if unlocked, '1' if locked with no waiters, and '2' if
+ *  locked with possibly parked waiters: the unlock only issues a wake
+ *  syscall in that last case.
+ */
+class spinlock_futex_t
+{
+    public:
+        typedef spinlock_no_node_t node_t;
+
+        constexpr spinlock_futex_t(unsigned int spin = SPINLOCK_FUTEX_SPIN) : spin(spin) {}
 
+        void
+        set_spin(unsigned int spin)
+        {
+            this->spin = spin;
+        }
+
+        void
+        lock(node_t &)
+        {
+            int c = 0;
+            for (unsigned int i = 0 ; i < this->spin ; ++i)
+            {
+                c = this->state;
+                if (c == 0 && (c = __sync_val_compare_and_swap(&this->state, 0, 1)) == 0)
+                    return ;
+                // someone is already parked: stop spinning
+                if (c == 2)
+                    break ;
+                mem_pause();
+            }
+
+            // slow path: mark the lock as contended, and park
+            if (c != 2)
+                c = __atomic_exchange_n(&this->state, 2, __ATOMIC_ACQUIRE);
+            while (c != 0)
+            {
+                spinlock_futex_t::wait(&this->state, 2);
+                c = __atomic_exchange_n(&this->state, 2, __ATOMIC_ACQUIRE);
+            }
+        }
+
+        bool
+        trylock(node_t &)
+        {
+            return __sync_val_compare_and_swap(&this->state, 0, 1) == 0;
+        }
+
+        void
+        unlock(node_t &)
+        {
+            if (__sync_fetch_and_sub(&this->state, 1) != 1)
+            {
+                this->state = 0;
+                spinlock_futex_t::wake(&this->state);
+            }
+        }
+
+    private:
+        alignas(SPINLOCK_CACHE_LINE_SIZE) volatile int state = 0;
+        unsigned int spin;
+
+        static void
+        wait(volatile int * addr, int val)
+        {
+# if defined(__linux__)
+            syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
 # else
+            (void) addr;
+            (void) val;
+            sched_yield();
+# endif
+        }
 
-# include <pthread.h>
-typedef pthread_mutex_t spinlock_t;
-# define SPINLOCK_LOCK(L)       pthread_mutex_lock(&L)
-# define SPINLOCK_UNLOCK(L)     pthread_mutex_unlock(&L)
-# define SPINLOCK_INITIALIZER   PTHREAD_MUTEX_INITIALIZER
+        static void
+        wake(volatile int * addr)
+        {
+# if defined(__linux__)
+            syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+# else
+            (void) addr;
+# endif
+        }
+};
+
+template <typename L>
+class spinlock_guard
+{
+    public:
+        spinlock_guard(L & l) : l(l)
+        {
+            this->l.lock(this->node);
+        }
+
+        ~spinlock_guard()
+        {
+            this->l.unlock(this->node);
+        }
+
+        spinlock_guard(const spinlock_guard &) = delete;
+        spinlock_guard & operator=(const spinlock_guard &) = delete;
+
+    private:
+        L & l;
+        typename L::node_t node;
+};
+
+/**
+ *  'SPINLOCK_LOCK' and 'SPINLOCK_UNLOCK' accept a 'spinlock_t' (test-and-set
+ *  on an int, initialized with 'SPINLOCK_INITIALIZER') or any node-less lock
+ *  of the family, so that each lock instance picks its implementation
+ *  through its type.
+ */
+typedef volatile int spinlock_t;
+
+# define SPINLOCK_INITIALIZER 0
+
+/* returns the number of failed attempts */
+static inline unsigned long
+spinlock_lock(spinlock_t & l)
+{
+    unsigned long spins = 0;
+    while (__sync_val_compare_and_swap(&l, 0, 1) == 1)
+    {
+        mem_pause();
+        ++spins;
+    }
+    return spins;
+}
+
+static inline bool
+spinlock_trylock(spinlock_t & l)
+{
+    return __sync_val_compare_and_swap(&l, 0, 1) == 0;
+}
+
+static inline void
+spinlock_unlock(spinlock_t & l)
+{
+    __sync_lock_release(&l);
+}
+
+/* the number of failed attempts is unknown for other locks: returns 0 */
+template <typename L>
+static inline unsigned long
+spinlock_lock(L & l)
+{
+    static_assert(std::is_same<typename L::node_t, spinlock_no_node_t>::value,
+            "Queued locks need a node: use 'spinlock_guard'");
+    spinlock_no_node_t node;
+    l.lock(node);
+    return 0;
+}
+
+template <typename L>
+static inline bool
+spinlock_trylock(L & l)
+{
+    spinlock_no_node_t node;
+    return l.trylock(node);
+}
+
+template <typename L>
+static inline void
+spinlock_unlock(L & l)
+{
+    spinlock_no_node_t node;
+    l.unlock(node);
+}
 
+/**
+ *  Contention instrumentation: if 'SPINLOCK_STATS' is '1', every
+ *  'SPINLOCK_LOCK' call site records, in per-thread counters (so that
+ *  recording creates no contention):
+ *      - the number of acquisitions
+ *      - the number of contended acquisitions (the first attempt failed)
+ *      - the number of spin iterations ('spinlock_t' only)
+ *      - a log2 histogram of the wait time of contended acquisitions, in ns
+ *  Statistics of every threads are dumped to stderr at exit, or on demand
+ *  with 'spinlock_stats_dump'. If '0', 'SPINLOCK_LOCK' is left untouched.
+ */
+# ifndef SPINLOCK_STATS
+#  define SPINLOCK_STATS 0
 # endif
 
+# if SPINLOCK_STATS
+
+#  include <stdio.h>
+#  include <stdlib.h>
+#  include <time.h>
+
+/* maximum number of call sites, the last one aggregates the others */
+#  define SPINLOCK_STATS_MAX_SITES  256
+
+/* number of histogram buckets: bucket 'i' counts waits in [2^i, 2^(i+1)[ ns */
+#  define SPINLOCK_STATS_HIST       32
+
+typedef struct  spinlock_stats_site_s
+{
+    char const *    file;
+    int             line;
+    char const *    name;
+}               spinlock_stats_site_t;
+
+typedef struct  spinlock_stats_counters_s
+{
+    uint64_t acquisitions;
+    uint64_t contended;
+    uint64_t spins;
+    uint64_t hist[SPINLOCK_STATS_HIST];
+}               spinlock_stats_counters_t;
+
+typedef struct  spinlock_stats_thread_s
+{
+    spinlock_stats_counters_t sites[SPINLOCK_STATS_MAX_SITES];
+    struct spinlock_stats_thread_s * next;
+}               spinlock_stats_thread_t;
+
+inline spinlock_stats_site_t                SPINLOCK_STATS_SITES[SPINLOCK_STATS_MAX_SITES];
+inline volatile unsigned int                SPINLOCK_STATS_NSITES   = 0;
+inline spinlock_stats_thread_t * volatile   SPINLOCK_STATS_THREADS  = NULL;
+inline thread_local spinlock_stats_thread_t * SPINLOCK_STATS_THREAD = NULL;
+
+static inline void
+spinlock_stats_dump(FILE * f)
+{
+    const unsigned int nsites = SPINLOCK_STATS_NSITES < SPINLOCK_STATS_MAX_SITES ?
+                                    SPINLOCK_STATS_NSITES : SPINLOCK_STATS_MAX_SITES;
+    fprintf(f, "[SPINLOCK] %-32s %-24s %12s %12s %14s  %s\n",
+            "site", "lock", "acquisitions", "contended", "spins", "wait histogram (log2 ns: count)");
+    for (unsigned int i = 0 ; i < nsites ; ++i)
+    {
+        spinlock_stats_counters_t total;
+        memset(&total, 0, sizeof(total));
+        for (spinlock_stats_thread_t * t = SPINLOCK_STATS_THREADS ; t ; t = t->next)
+        {
+            total.acquisitions  += t->sites[i].acquisitions;
+            total.contended     += t->sites[i].contended;
+            total.spins         += t->sites[i].spins;
+            for (unsigned int j = 0 ; j < SPINLOCK_STATS_HIST ; ++j)
+                total.hist[j]   += t->sites[i].hist[j];
+        }
+
+        char site[256];
+        if (i == SPINLOCK_STATS_MAX_SITES - 1 && SPINLOCK_STATS_NSITES > SPINLOCK_STATS_MAX_SITES)
+            snprintf(site, sizeof(site), "<others>");
+        else
+            snprintf(site, sizeof(site), "%s:%d", SPINLOCK_STATS_SITES[i].file, SPINLOCK_STATS_SITES[i].line);
+
+        fprintf(f, "[SPINLOCK] %-32s %-24s %12lu %12lu %14lu ",
+                site, SPINLOCK_STATS_SITES[i].name, total.acquisitions, total.contended, total.spins);
+        for (unsigned int j = 0 ; j < SPINLOCK_STATS_HIST ; ++j)
+            if (total.hist[j])
+                fprintf(f, " %u:%lu", j, total.hist[j]);
+        fprintf(f, "\n");
+    }
+}
+
+static inline void
+spinlock_stats_atexit(void)
+{
+    spinlock_stats_dump(stderr);
+}
+
+static inline unsigned int
+spinlock_stats_register(char const * file, int line, char const * name)
+{
+    const unsigned int id = __sync_fetch_and_add(&SPINLOCK_STATS_NSITES, 1);
+    if (id == 0)
+        atexit(spinlock_stats_atexit);
+    if (id >= SPINLOCK_STATS_MAX_SITES - 1)
+    {
+        SPINLOCK_STATS_SITES[SPINLOCK_STATS_MAX_SITES - 1].name = "";
+        return SPINLOCK_STATS_MAX_SITES - 1;
+    }
+    SPINLOCK_STATS_SITES[id].file = file;
+    SPINLOCK_STATS_SITES[id].line = line;
+    SPINLOCK_STATS_SITES[id].name = name;
+    return id;
+}
+
+static inline spinlock_stats_counters_t *
+spinlock_stats_counters(unsigned int site)
+{
+    spinlock_stats_thread_t * t = SPINLOCK_STATS_THREAD;
+    if (t == NULL)
+    {
+        t = (spinlock_stats_thread_t *) calloc(1, sizeof(spinlock_stats_thread_t));
+        if (t == NULL)
+            abort();
+        do {
+            t->next = SPINLOCK_STATS_THREADS;
+        } while (!__sync_bool_compare_and_swap(&SPINLOCK_STATS_THREADS, t->next, t));
+        SPINLOCK_STATS_THREAD = t;
+    }
+    return t->sites + site;
+}
+
+static inline uint64_t
+spinlock_stats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+template <typename L>
+static inline void
+spinlock_stats_lock(L & l, unsigned int site)
+{
+    spinlock_stats_counters_t * c = spinlock_stats_counters(site);
+    ++c->acquisitions;
+    if (spinlock_trylock(l))
+        return ;
+
+    const uint64_t t0 = spinlock_stats_now();
+    c->spins += spinlock_lock(l);
+    const uint64_t wait = spinlock_stats_now() - t0;
+
+    ++c->contended;
+    const unsigned int bucket = wait ? 63 - __builtin_clzll(wait) : 0;
+    ++c->hist[bucket < SPINLOCK_STATS_HIST ? bucket : SPINLOCK_STATS_HIST - 1];
+}
+
+#  define SPINLOCK_LOCK(L)                                              \
+    do {                                                                \
+        static const unsigned int _site =                               \
+            spinlock_stats_register(__FILE__, __LINE__, #L);            \
+        spinlock_stats_lock(L, _site);                                  \
+    } while (0)
+
+# else /* SPINLOCK_STATS */
+
+#  define SPINLOCK_LOCK(L)   spinlock_lock(L)
+
+# endif /* SPINLOCK_STATS */
+
+# define SPINLOCK_UNLOCK(L) spinlock_unlock(L)
+
 #endif /* __SPINLOCK_H__ */
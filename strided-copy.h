@@ -0,0 +1,269 @@
+#ifndef __STRIDED_COPY_H__
+# define __STRIDED_COPY_H__
+
+/**
+ *  Strided copies of 3D regions, in batches, on a Level Zero command list
+ *  or on the host.
+ *
+ *  A region copies a box of 'depth' slices of 'height' rows of 'width'
+ *  bytes. The row 'y' of the slice 'z' of the box starts at
+ *      src + (src_z + z) * src_slice_pitch + (src_y + y) * src_pitch + src_x
+ *  and goes to the same place in 'dst' (with the 'dst_*' origin and
+ *  pitches). A 2D region has a 'depth' of 1 and no slice pitch.
+ *
+ *      strided_region_t r = strided_region_2d(dst, src, dst_pitch, src_pitch, width, height);
+ *      strided_copy_ze(list, &r, 1, event, 0, NULL);   // on the device
+ *      strided_copy_host(&r, 1);                       // or on the host
+ *
+ *  'strided_copy_ze' appends a batch of regions to a command list: each
+ *  region waits for the 'wait' events, and 'signal' is signaled once all
+ *  regions completed (by the copy itself for a single region, by a barrier
+ *  otherwise). 'strided_copy_host' copies each slice with 'memcpy2d_host'
+ *  (see memcpy2d-host.h), so that the same batches run without a device.
+ *  Level Zero takes 32-bit pitches: 'strided_copy_ze' aborts on a (slice)
+ *  pitch of 4 GiB or more, which only 'strided_copy_host' supports.
+ *
+ *  Halo exchanges of stencil codes are batches of 6 regions (one per face)
+ *  built by 'strided_halo_regions', from the fields of a subdomain and of
+ *  its neighbours (see 'strided_field_t'). Faces cover the interior extent
+ *  of the other axes only: edges and corners of the halo, which star
+ *  stencils do not read, are not exchanged.
+ */
+
+# include <stdint.h>
+# include <string.h>
+
+# include <ze_api.h>
+
+# include "logger-ze.h"
+# include "memcpy2d-host.h"
+
+typedef struct  strided_region_s
+{
+    void * dst;
+    const void * src;
+    size_t dst_pitch, dst_slice_pitch;
+    size_t src_pitch, src_slice_pitch;
+    uint32_t dst_x, dst_y, dst_z;   // origin, 'x' in bytes
+    uint32_t src_x, src_y, src_z;
+    uint32_t width;                 // in bytes
+    uint32_t height;
+    uint32_t depth;
+}               strided_region_t;
+
+static inline strided_region_t
+strided_region_2d(
+    void * dst, const void * src,
+    size_t dst_pitch, size_t src_pitch,
+    uint32_t width, uint32_t height,
+    uint32_t dst_x = 0, uint32_t src_x = 0
+) {
+    strided_region_t r;
+    memset(&r, 0, sizeof(r));
+    r.dst       = dst;
+    r.src       = src;
+    r.dst_pitch = dst_pitch;
+    r.src_pitch = src_pitch;
+    r.dst_x     = dst_x;
+    r.src_x     = src_x;
+    r.width     = width;
+    r.height    = height;
+    r.depth     = 1;
+    return r;
+}
+
+// append a region, signaling 'signal' once copied
+static inline void
+strided_copy_ze_region(
+    ze_command_list_handle_t list,
+    const strided_region_t * region,
+    ze_event_handle_t signal, uint32_t nwait, ze_event_handle_t * wait
+) {
+    // the pitches of 'zeCommandListAppendMemoryCopyRegion' are 32 bits
+    if (region->dst_pitch > UINT32_MAX || region->dst_slice_pitch > UINT32_MAX ||
+            region->src_pitch > UINT32_MAX || region->src_slice_pitch > UINT32_MAX)
+        LOGGER_FATAL("Pitches of %zu/%zu (dst) and %zu/%zu (src) bytes exceed the 4 GiB of a device copy",
+                region->dst_pitch, region->dst_slice_pitch, region->src_pitch, region->src_slice_pitch);
+
+    // 2D regions have a depth of 0
+    const uint32_t depth = region->depth > 1 || region->dst_slice_pitch || region->src_slice_pitch ? region->depth : 0;
+
+    const ze_copy_region_t dst_region = {
+        .originX = region->dst_x,
+        .originY = region->dst_y,
+        .originZ = region->dst_z,
+        .width   = region->width,
+        .height  = region->height,
+        .depth   = depth
+    };
+
+    const ze_copy_region_t src_region = {
+        .originX = region->src_x,
+        .originY = region->src_y,
+        .originZ = region->src_z,
+        .width   = region->width,
+        .height  = region->height,
+        .depth   = depth
+    };
+
+    ZE_SAFE_CALL(
+        zeCommandListAppendMemoryCopyRegion(
+            list,
+            region->dst, &dst_region, (uint32_t) region->dst_pitch, (uint32_t) region->dst_slice_pitch,
+            region->src, &src_region, (uint32_t) region->src_pitch, (uint32_t) region->src_slice_pitch,
+            signal, nwait, wait
+        )
+    );
+}
+
+// append a batch of 'n' regions, signaling 'signal' once all are copied
+static inline void
+strided_copy_ze(
+    ze_command_list_handle_t list,
+    const strided_region_t * regions, unsigned int n,
+    ze_event_handle_t signal, uint32_t nwait, ze_event_handle_t * wait
+) {
+    if (n == 1)
+    {
+        strided_copy_ze_region(list, regions, signal, nwait, wait);
+        return ;
+    }
+    for (unsigned int i = 0 ; i < n ; ++i)
+        strided_copy_ze_region(list, regions + i, NULL, nwait, wait);
+    if (signal)
+        ZE_SAFE_CALL(zeCommandListAppendBarrier(list, signal, 0, NULL));
+}
+
+// copy a batch of 'n' regions on the host
+static inline void
+strided_copy_host(const strided_region_t * regions, unsigned int n)
+{
+    for (unsigned int i = 0 ; i < n ; ++i)
+    {
+        const strided_region_t & r = regions[i];
+        for (uint32_t z = 0 ; z < r.depth ; ++z)
+        {
+                  char * dst = (      char *) r.dst + (r.dst_z + z) * r.dst_slice_pitch + r.dst_y * r.dst_pitch;
+            const char * src = (const char *) r.src + (r.src_z + z) * r.src_slice_pitch + r.src_y * r.src_pitch;
+            memcpy2d_host(dst, src, r.dst_pitch, r.src_pitch, r.width, r.height, r.dst_x, r.src_x);
+        }
+    }
+}
+
+/**
+ *  A 3D field of 'nx * ny * nz' elements of 'elem' bytes, surrounded by
+ *  'halo' layers on each side: element (x, y, z) of the interior, with
+ *  0 <= x < nx, is at
+ *      ptr + (z + halo) * slice_pitch + (y + halo) * pitch + (x + halo) * elem
+ *  with 'pitch >= (nx + 2 * halo) * elem' and 'slice_pitch >= (ny + 2 * halo) * pitch'.
+ */
+typedef struct  strided_field_s
+{
+    char * ptr;
+    size_t elem;
+    uint32_t nx, ny, nz;
+    uint32_t halo;
+    size_t pitch;
+    size_t slice_pitch;
+}               strided_field_t;
+
+typedef enum    strided_face_e
+{
+    STRIDED_FACE_XLO,
+    STRIDED_FACE_XHI,
+    STRIDED_FACE_YLO,
+    STRIDED_FACE_YHI,
+    STRIDED_FACE_ZLO,
+    STRIDED_FACE_ZHI,
+    STRIDED_FACE_MAX
+}               strided_face_t;
+
+static const char * STRIDED_FACE_NAMES[STRIDED_FACE_MAX] __attribute__((unused)) = {
+    "x-", "x+", "y-", "y+", "z-", "z+"
+};
+
+// a field with its pitches set for a dense storage of its interior and halo
+static inline strided_field_t
+strided_field(char * ptr, size_t elem, uint32_t nx, uint32_t ny, uint32_t nz, uint32_t halo)
+{
+    strided_field_t f;
+    f.ptr         = ptr;
+    f.elem        = elem;
+    f.nx          = nx;
+    f.ny          = ny;
+    f.nz          = nz;
+    f.halo        = halo;
+    f.pitch       = (nx + 2 * halo) * elem;
+    f.slice_pitch = (ny + 2 * halo) * f.pitch;
+    return f;
+}
+
+static inline size_t
+strided_field_size(const strided_field_t * f)
+{
+    return (f->nz + 2 * f->halo) * f->slice_pitch;
+}
+
+/**
+ *  The region sending the interior layers of 'from' along its face 'face'
+ *  to the halo of its neighbour 'to' on that side: the 'x+' face of 'from'
+ *  fills the 'x-' halo of 'to'. Both fields have the same shape, and 'to'
+ *  may be 'from' for periodic boundaries.
+ */
+static inline strided_region_t
+strided_halo_region(const strided_field_t * from, const strided_field_t * to, strided_face_t face)
+{
+    const uint32_t h = from->halo;
+    strided_region_t r;
+    r.dst             = to->ptr;
+    r.src             = from->ptr;
+    r.dst_pitch       = to->pitch;
+    r.dst_slice_pitch = to->slice_pitch;
+    r.src_pitch       = from->pitch;
+    r.src_slice_pitch = from->slice_pitch;
+
+    // interior box, in storage coordinates
+    uint32_t src[3] = { h, h, h };
+    uint32_t dst[3] = { h, h, h };
+    uint32_t size[3] = { from->nx, from->ny, from->nz };
+    const uint32_t n[3] = { from->nx, from->ny, from->nz };
+
+    const unsigned int axis = face / 2;
+    if (face % 2 == 0)
+    {
+        // low interior layers, to the high halo
+        src[axis] = h;
+        dst[axis] = h + n[axis];
+    }
+    else
+    {
+        // high interior layers, to the low halo
+        src[axis] = n[axis];
+        dst[axis] = 0;
+    }
+    size[axis] = h;
+
+    r.src_x  = src[0] * from->elem;
+    r.src_y  = src[1];
+    r.src_z  = src[2];
+    r.dst_x  = dst[0] * to->elem;
+    r.dst_y  = dst[1];
+    r.dst_z  = dst[2];
+    r.width  = size[0] * from->elem;
+    r.height = size[1];
+    r.depth  = size[2];
+    return r;
+}
+
+// the 6 regions of the halo exchange of 'field' with its 'neighbours', indexed by face
+static inline void
+strided_halo_regions(
+    const strided_field_t * field,
+    const strided_field_t * const neighbours[STRIDED_FACE_MAX],
+    strided_region_t regions[STRIDED_FACE_MAX]
+) {
+    for (int face = 0 ; face < STRIDED_FACE_MAX ; ++face)
+        regions[face] = strided_halo_region(field, neighbours[face], (strided_face_t) face);
+}
+
+#endif /* __STRIDED_COPY_H__ */
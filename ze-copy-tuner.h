@@ -0,0 +1,371 @@
+#ifndef __ZE_COPY_TUNER_H__
+# define __ZE_COPY_TUNER_H__
+
+/**
+ *  Copy strategies of pitched 2D copies, and an autotuner picking the
+ *  fastest one per shape, remembered across runs.
+ *
+ *      copy_tuner_t tuner;
+ *      copy_tuner_init(&tuner, &ze, engines, nengines, &events);
+ *      copy_tuner_copy(&tuner, COPY_STRATEGY_AUTO, engine, COPY_H2D,
+ *              dst, src, dst_pitch, src_pitch, width, height, dst_x, src_x, event);
+ *      ... wait for the copies ...
+ *      copy_tuner_release(&tuner);
+ *      copy_tuner_deinit(&tuner);
+ *
+ *  Strategies:
+ *      - region    one 'zeCommandListAppendMemoryCopyRegion', as given
+ *      - pointer   same, with the origins folded into the pointers
+ *      - rows      one 'zeCommandListAppendMemoryCopy' per row, then a
+ *                  barrier signaling the event
+ *      - chunks    rows split into one region per engine, starting from
+ *                  'engine', then a barrier on 'engine' waiting for them
+ *      - auto      the fastest of the above for the bucket of the copy
+ *
+ *  Copies are bucketed by direction, by the number of engines 'chunks' may
+ *  spread them on ('nengines', which may be lowered between copies, e.g.
+ *  per configuration of a sweep), and by the next power of 2 of their
+ *  width, height and (largest) pitch. The first 'auto' copy of a bucket
+ *  runs every strategy on its own buffers 'COPY_TUNER_REPS' times after a
+ *  warmup, synchronously (the copies are idempotent), and keeps the one
+ *  with the smallest median time.
+ *
+ *  Winners are appended to a text cache, one line per bucket:
+ *      DEVICE_UUID DRIVER_VERSION DIRECTION ENGINES LOG2_WIDTH LOG2_HEIGHT LOG2_PITCH STRATEGY
+ *  and lines of the current device and driver version are loaded at init,
+ *  so that later runs do not tune again. The cache is
+ *  '$ZE_COPY_TUNER_CACHE', or '$XDG_CACHE_HOME/ze-copy-tuner' (default
+ *  '$HOME/.cache/ze-copy-tuner'); an empty 'ZE_COPY_TUNER_CACHE' disables
+ *  it. Remove the file to tune again.
+ *
+ *  'chunks' events come from the event allocator, and are only recycled by
+ *  'copy_tuner_release', once the copies issued so far completed.
+ */
+
+# include <errno.h>
+# include <limits.h>
+# include <stdint.h>
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <sys/stat.h>
+# include <time.h>
+
+# include <algorithm>
+# include <map>
+# include <vector>
+
+# include <ze_api.h>
+
+# include "logger-ze.h"
+# include "strided-copy.h"
+# include "ze-device.h"
+# include "ze-event-pool.h"
+
+// timed runs of each strategy when tuning
+# ifndef COPY_TUNER_REPS
+#  define COPY_TUNER_REPS 5
+# endif
+
+typedef enum    copy_strategy_e
+{
+    COPY_STRATEGY_REGION,
+    COPY_STRATEGY_POINTER,
+    COPY_STRATEGY_ROWS,
+    COPY_STRATEGY_CHUNKS,
+    COPY_STRATEGY_AUTO,
+    COPY_STRATEGY_MAX
+}               copy_strategy_t;
+
+static const char * COPY_STRATEGY_NAMES[COPY_STRATEGY_MAX] __attribute__((unused)) = {
+    "region",
+    "pointer",
+    "rows",
+    "chunks",
+    "auto"
+};
+
+typedef enum    copy_direction_e
+{
+    COPY_H2D,
+    COPY_D2H,
+    COPY_DIRECTION_MAX
+}               copy_direction_t;
+
+static const char * COPY_DIRECTION_NAMES[COPY_DIRECTION_MAX] __attribute__((unused)) = {
+    "h2d",
+    "d2h"
+};
+
+typedef struct  copy_tuner_s
+{
+    ze_engine_t * engines;
+    unsigned int nengines;                      // 'chunks' use engines [0, nengines)
+    event_allocator_t * events;
+    std::vector<event_t *> retired;             // 'chunks' events of the copies in flight
+    std::map<uint64_t, copy_strategy_t> best;   // strategy of each bucket
+    char uuid[2 * ZE_MAX_DEVICE_UUID_SIZE + 1]; // of the device, in hexadecimal
+    uint32_t version;                           // of the driver
+    char path[PATH_MAX];                        // cache, empty if none
+}               copy_tuner_t;
+
+// the smallest 'l' with 'x <= 2^l'
+static inline uint32_t
+copy_tuner_log2(size_t x)
+{
+    return x <= 1 ? 0 : 64 - __builtin_clzll((unsigned long long) x - 1);
+}
+
+static inline uint64_t
+copy_tuner_bucket(copy_direction_t direction, unsigned int nengines, size_t width, size_t height, size_t pitch)
+{
+    return (uint64_t) nengines << 32 | (uint32_t) direction << 24 |
+        copy_tuner_log2(width) << 16 | copy_tuner_log2(height) << 8 | copy_tuner_log2(pitch);
+}
+
+// the cache file, or 'false' if disabled
+static inline bool
+copy_tuner_path(char * path, size_t size)
+{
+    const char * env = getenv("ZE_COPY_TUNER_CACHE");
+    if (env)
+    {
+        snprintf(path, size, "%s", env);
+        return path[0] != '\0';
+    }
+
+    char dir[PATH_MAX];
+    const char * xdg  = getenv("XDG_CACHE_HOME");
+    const char * home = getenv("HOME");
+    if (xdg && xdg[0])
+        snprintf(dir, sizeof(dir), "%s", xdg);
+    else if (home && home[0])
+        snprintf(dir, sizeof(dir), "%s/.cache", home);
+    else
+        return false;
+    if (mkdir(dir, 0755) && errno != EEXIST)
+        return false;
+    snprintf(path, size, "%s/ze-copy-tuner", dir);
+    return true;
+}
+
+static inline void
+copy_tuner_load(copy_tuner_t * tuner)
+{
+    FILE * f = fopen(tuner->path, "r");
+    if (f == NULL)
+        return ;
+
+    // line by line, so that lines of another format are skipped
+    char line[256];
+    char uuid[sizeof(tuner->uuid)], direction[8], strategy[16];
+    uint32_t version, nengines, lw, lh, lp;
+    while (fgets(line, sizeof(line), f))
+    {
+        if (sscanf(line, "%32s %u %7s %u %u %u %u %15s", uuid, &version, direction, &nengines, &lw, &lh, &lp, strategy) != 8)
+            continue ;
+        if (strcmp(uuid, tuner->uuid) || version != tuner->version)
+            continue ;
+
+        int d, s;
+        for (d = 0 ; d < COPY_DIRECTION_MAX && strcmp(direction, COPY_DIRECTION_NAMES[d]) ; ++d)
+            ;
+        for (s = 0 ; s < COPY_STRATEGY_AUTO && strcmp(strategy, COPY_STRATEGY_NAMES[s]) ; ++s)
+            ;
+        if (d == COPY_DIRECTION_MAX || s == COPY_STRATEGY_AUTO)
+            continue ;
+        tuner->best[(uint64_t) nengines << 32 | (uint32_t) d << 24 | lw << 16 | lh << 8 | lp] = (copy_strategy_t) s;
+    }
+    fclose(f);
+    LOGGER_DEBUG("Loaded %zu tuned copy buckets from `%s`", tuner->best.size(), tuner->path);
+}
+
+static inline void
+copy_tuner_save(const copy_tuner_t * tuner, uint64_t bucket, copy_strategy_t strategy)
+{
+    if (tuner->path[0] == '\0')
+        return ;
+    FILE * f = fopen(tuner->path, "a");
+    if (f == NULL)
+    {
+        LOGGER_WARN("Cannot write the copy tuner cache `%s`", tuner->path);
+        return ;
+    }
+    fprintf(f, "%s %u %s %u %u %u %u %s\n", tuner->uuid, tuner->version, COPY_DIRECTION_NAMES[(bucket >> 24) & 0xFF],
+            (unsigned int) (bucket >> 32), (unsigned int) (bucket >> 16) & 0xFF, (unsigned int) (bucket >> 8) & 0xFF,
+            (unsigned int) bucket & 0xFF, COPY_STRATEGY_NAMES[strategy]);
+    fclose(f);
+}
+
+static inline void
+copy_tuner_init(copy_tuner_t * tuner, const ze_device_t * ze, ze_engine_t * engines, unsigned int nengines, event_allocator_t * events)
+{
+    tuner->engines  = engines;
+    tuner->nengines = nengines;
+    tuner->events   = events;
+
+    ze_device_properties_t deviceProperties;
+    memset(&deviceProperties, 0, sizeof(deviceProperties));
+    deviceProperties.stype = ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES;
+    ZE_SAFE_CALL(zeDeviceGetProperties(ze->device, &deviceProperties));
+
+    ze_driver_properties_t driverProperties;
+    memset(&driverProperties, 0, sizeof(driverProperties));
+    driverProperties.stype = ZE_STRUCTURE_TYPE_DRIVER_PROPERTIES;
+    ZE_SAFE_CALL(zeDriverGetProperties(ze->driver, &driverProperties));
+
+    for (unsigned int b = 0 ; b < ZE_MAX_DEVICE_UUID_SIZE ; ++b)
+        sprintf(tuner->uuid + 2 * b, "%02x", deviceProperties.uuid.id[b]);
+    tuner->version = driverProperties.driverVersion;
+
+    if (copy_tuner_path(tuner->path, sizeof(tuner->path)))
+        copy_tuner_load(tuner);
+    else
+        tuner->path[0] = '\0';
+}
+
+// recycle the events of the copies issued so far, which must have completed
+static inline void
+copy_tuner_release(copy_tuner_t * tuner)
+{
+    for (event_t * e : tuner->retired)
+        event_free(tuner->events, e);
+    tuner->retired.clear();
+}
+
+static inline void
+copy_tuner_deinit(copy_tuner_t * tuner)
+{
+    copy_tuner_release(tuner);
+    tuner->best.clear();
+}
+
+static inline copy_strategy_t
+copy_tuner_strategy(
+    copy_tuner_t * tuner, unsigned int engine, copy_direction_t direction,
+    void * dst, const void * src, size_t dst_pitch, size_t src_pitch,
+    uint32_t width, uint32_t height, uint32_t dst_x, uint32_t src_x
+);
+
+// append a pitched copy with 'strategy', signaling 'signal' once copied
+static inline void
+copy_tuner_copy(
+    copy_tuner_t * tuner, copy_strategy_t strategy, unsigned int engine, copy_direction_t direction,
+    void * dst, const void * src, size_t dst_pitch, size_t src_pitch,
+    uint32_t width, uint32_t height, uint32_t dst_x, uint32_t src_x,
+    ze_event_handle_t signal
+) {
+    if (strategy == COPY_STRATEGY_AUTO)
+        strategy = copy_tuner_strategy(tuner, engine, direction, dst, src, dst_pitch, src_pitch, width, height, dst_x, src_x);
+    if (strategy == COPY_STRATEGY_CHUNKS && (tuner->nengines < 2 || height < 2))
+        strategy = COPY_STRATEGY_REGION;
+
+    ze_command_list_handle_t list = tuner->engines[engine].list;
+    switch (strategy)
+    {
+        case (COPY_STRATEGY_POINTER):
+            dst = (char *) dst + dst_x;
+            src = (const char *) src + src_x;
+            dst_x = src_x = 0;
+            // fallthrough
+        case (COPY_STRATEGY_REGION):
+        {
+            const strided_region_t region = strided_region_2d(dst, src, dst_pitch, src_pitch, width, height, dst_x, src_x);
+            strided_copy_ze_region(list, &region, signal, 0, NULL);
+            break ;
+        }
+
+        case (COPY_STRATEGY_ROWS):
+            for (uint32_t y = 0 ; y < height ; ++y)
+                ZE_SAFE_CALL(zeCommandListAppendMemoryCopy(list,
+                            (char *) dst + y * dst_pitch + dst_x, (const char *) src + y * src_pitch + src_x, width,
+                            NULL, 0, NULL));
+            ZE_SAFE_CALL(zeCommandListAppendBarrier(list, signal, 0, NULL));
+            break ;
+
+        case (COPY_STRATEGY_CHUNKS):
+        {
+            const unsigned int nchunks = std::min(tuner->nengines, height);
+            const uint32_t rows = (height + nchunks - 1) / nchunks;
+            std::vector<ze_event_handle_t> chunks;
+            for (uint32_t y = 0, k = 0 ; y < height ; y += rows, ++k)
+            {
+                event_t * e = event_alloc(tuner->events);
+                tuner->retired.push_back(e);
+                chunks.push_back(e->event);
+
+                const strided_region_t region = strided_region_2d(
+                        (char *) dst + y * dst_pitch, (const char *) src + y * src_pitch,
+                        dst_pitch, src_pitch, width, std::min(rows, height - y), dst_x, src_x);
+                strided_copy_ze_region(tuner->engines[(engine + k) % tuner->nengines].list, &region, e->event, 0, NULL);
+            }
+            ZE_SAFE_CALL(zeCommandListAppendBarrier(list, signal, (uint32_t) chunks.size(), chunks.data()));
+            break ;
+        }
+
+        default:
+            LOGGER_FATAL("Unknown copy strategy");
+    }
+}
+
+// the strategy of the bucket of a copy, tuned on its buffers if unknown
+static inline copy_strategy_t
+copy_tuner_strategy(
+    copy_tuner_t * tuner, unsigned int engine, copy_direction_t direction,
+    void * dst, const void * src, size_t dst_pitch, size_t src_pitch,
+    uint32_t width, uint32_t height, uint32_t dst_x, uint32_t src_x
+) {
+    const uint64_t bucket = copy_tuner_bucket(direction, tuner->nengines, width, height, std::max(dst_pitch, src_pitch));
+    auto it = tuner->best.find(bucket);
+    if (it != tuner->best.end())
+        return it->second;
+
+    // events of the copies issued before the tuning, still in flight
+    const size_t inflight = tuner->retired.size();
+    event_t * done = event_alloc(tuner->events);
+    copy_strategy_t best = COPY_STRATEGY_REGION;
+    double best_us = 0;
+    double us[COPY_STRATEGY_AUTO] = {};
+    for (int s = 0 ; s < COPY_STRATEGY_AUTO ; ++s)
+    {
+        // same commands as 'region'
+        if (s == COPY_STRATEGY_POINTER && dst_x == 0 && src_x == 0)
+            continue ;
+        if (s == COPY_STRATEGY_CHUNKS && (tuner->nengines < 2 || height < 2))
+            continue ;
+
+        uint64_t ns[COPY_TUNER_REPS];
+        for (int r = -1 ; r < COPY_TUNER_REPS ; ++r)
+        {
+            struct timespec t0, t1;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            copy_tuner_copy(tuner, (copy_strategy_t) s, engine, direction,
+                    dst, src, dst_pitch, src_pitch, width, height, dst_x, src_x, done->event);
+            ZE_SAFE_CALL(zeEventHostSynchronize(done->event, UINT64_MAX));
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            ZE_SAFE_CALL(zeEventHostReset(done->event));
+            for (size_t k = inflight ; k < tuner->retired.size() ; ++k)
+                event_free(tuner->events, tuner->retired[k]);
+            tuner->retired.resize(inflight);
+            if (r >= 0)
+                ns[r] = (uint64_t) (t1.tv_sec - t0.tv_sec) * 1000000000 + (uint64_t) (t1.tv_nsec - t0.tv_nsec);
+        }
+        std::sort(ns, ns + COPY_TUNER_REPS);
+        us[s] = (double) ns[COPY_TUNER_REPS / 2] / 1e3;
+        if (best_us == 0 || us[s] < best_us)
+        {
+            best    = (copy_strategy_t) s;
+            best_us = us[s];
+        }
+    }
+    event_free(tuner->events, done);
+
+    LOGGER_INFO("Tuned %s copies of %u x %u bytes (pitch %zu) on %u engines: `%s` (region %.1lf, pointer %.1lf, rows %.1lf, chunks %.1lf us)",
+            COPY_DIRECTION_NAMES[direction], width, height, std::max(dst_pitch, src_pitch), tuner->nengines, COPY_STRATEGY_NAMES[best],
+            us[COPY_STRATEGY_REGION], us[COPY_STRATEGY_POINTER], us[COPY_STRATEGY_ROWS], us[COPY_STRATEGY_CHUNKS]);
+    tuner->best[bucket] = best;
+    copy_tuner_save(tuner, bucket, best);
+    return best;
+}
+
+#endif /* __ZE_COPY_TUNER_H__ */
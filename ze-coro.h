@@ -0,0 +1,241 @@
+#ifndef __ZE_CORO_H__
+# define __ZE_CORO_H__
+
+/**
+ *  Awaitable copies (C++20 coroutines), resumed by a reactor thread once
+ *  their event signaled.
+ *
+ *      ze_task
+ *      transfer(ze_reactor_t * r, ze_command_list_handle_t list, strided_region_t h2d, strided_region_t d2h)
+ *      {
+ *          co_await copy_region(r, list, h2d);
+ *          co_await copy_region(r, list, d2h);
+ *      }
+ *
+ *      ze_reactor_t r;
+ *      ze_reactor_init(&r, &events, ZE_REACTOR_POLL);
+ *      ze_task t = transfer(&r, list, h2d, d2h);
+ *      ze_task_start(&r, t);
+ *      ze_task_join(t);
+ *      ze_reactor_deinit(&r);
+ *
+ *  Tasks start suspended, and 'ze_task_start' hands them to the reactor:
+ *  every task runs on the reactor thread only, so that command lists are
+ *  only appended to by that thread, and one thread drives any number of
+ *  tasks. 'copy_region' appends a copy signaling an event of the event
+ *  allocator; awaiting it suspends the task until the reactor sees the
+ *  event signaled (the event is recycled on resumption).
+ *
+ *  The reactor sweeps the events awaited:
+ *      - poll      'zeEventQueryStatus' on each, 'sched_yield' after a
+ *                  sweep finding none signaled
+ *      - block     same, but 'zeEventHostSynchronize' on the oldest event,
+ *                  for at most 'ZE_REACTOR_TIMEOUT_NS', after such a sweep
+ *
+ *  'ze_task_join' blocks (on a C++20 atomic wait) until the task returned,
+ *  and destroys it. The flag it waits on is shared by the task and its
+ *  frame, so that setting it from the final suspension point never touches
+ *  a frame already destroyed. Tasks must not throw.
+ */
+
+# include <sched.h>
+# include <stdint.h>
+
+# include <atomic>
+# include <coroutine>
+# include <exception>
+# include <memory>
+# include <thread>
+# include <vector>
+
+# include <ze_api.h>
+
+# include "logger-ze.h"
+# include "spinlock.h"
+# include "strided-copy.h"
+# include "ze-event-pool.h"
+
+// longest block on an event, so that new awaits are not delayed further
+# ifndef ZE_REACTOR_TIMEOUT_NS
+#  define ZE_REACTOR_TIMEOUT_NS (100 * 1000)
+# endif
+
+typedef enum    ze_reactor_mode_e
+{
+    ZE_REACTOR_POLL,
+    ZE_REACTOR_BLOCK,
+    ZE_REACTOR_MAX
+}               ze_reactor_mode_t;
+
+static const char * ZE_REACTOR_NAMES[ZE_REACTOR_MAX] __attribute__((unused)) = {
+    "poll",
+    "block"
+};
+
+// a coroutine to resume once 'event' signaled, or right away if NULL
+typedef struct  ze_reactor_wait_s
+{
+    ze_event_handle_t event;
+    std::coroutine_handle<> coroutine;
+}               ze_reactor_wait_t;
+
+typedef struct  ze_reactor_s
+{
+    event_allocator_t * events;
+    ze_reactor_mode_t mode;
+    std::thread thread;
+    std::atomic<bool> stop;
+    spinlock_tas_t lock;                        // protects 'incoming'
+    std::vector<ze_reactor_wait_t> incoming;    // posted since the last sweep
+    std::atomic<uint64_t> nresumed;
+}               ze_reactor_t;
+
+class ze_task
+{
+    public:
+        struct promise_type
+        {
+            // outside of the frame, which 'ze_task_join' may destroy as soon as it is set
+            std::shared_ptr<std::atomic<bool>> finished = std::make_shared<std::atomic<bool>>(false);
+
+            ze_task get_return_object() { return ze_task(std::coroutine_handle<promise_type>::from_promise(*this), this->finished); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+
+            // flag the task once suspended for good, so that 'ze_task_join' may destroy it
+            struct final_awaiter
+            {
+                bool await_ready() noexcept { return false; }
+                void await_suspend(std::coroutine_handle<promise_type> h) noexcept
+                {
+                    // the frame must not be touched once the flag is set
+                    std::shared_ptr<std::atomic<bool>> finished = std::move(h.promise().finished);
+                    finished->store(true, std::memory_order_release);
+                    finished->notify_all();
+                }
+                void await_resume() noexcept {}
+            };
+            final_awaiter final_suspend() noexcept { return {}; }
+        };
+
+        ze_task(std::coroutine_handle<promise_type> h, std::shared_ptr<std::atomic<bool>> f) : handle(h), finished(std::move(f)) {}
+        ze_task(ze_task && other) noexcept : handle(other.handle), finished(std::move(other.finished)) { other.handle = nullptr; }
+        ze_task(const ze_task &) = delete;
+        ~ze_task() { if (this->handle) this->handle.destroy(); }
+
+        std::coroutine_handle<promise_type> handle;
+        std::shared_ptr<std::atomic<bool>> finished;
+};
+
+// hand a coroutine to the reactor, resumed once 'event' signaled
+static inline void
+ze_reactor_post(ze_reactor_t * r, ze_event_handle_t event, std::coroutine_handle<> coroutine)
+{
+    spinlock_guard<spinlock_tas_t> guard(r->lock);
+    r->incoming.push_back({ event, coroutine });
+}
+
+static inline void
+ze_reactor_loop(ze_reactor_t * r)
+{
+    std::vector<ze_reactor_wait_t> pending;
+    std::vector<ze_reactor_wait_t> ready;
+    while (!r->stop.load(std::memory_order_acquire))
+    {
+        {
+            spinlock_guard<spinlock_tas_t> guard(r->lock);
+            pending.insert(pending.end(), r->incoming.begin(), r->incoming.end());
+            r->incoming.clear();
+        }
+
+        // keep the pending ones in order, the oldest first
+        size_t j = 0;
+        for (size_t k = 0 ; k < pending.size() ; ++k)
+        {
+            ze_result_t res = pending[k].event ? zeEventQueryStatus(pending[k].event) : ZE_RESULT_SUCCESS;
+            if (res == ZE_RESULT_SUCCESS)
+                ready.push_back(pending[k]);
+            else if (res == ZE_RESULT_NOT_READY)
+                pending[j++] = pending[k];
+            else
+                ZE_SAFE_CALL(res);
+        }
+        pending.resize(j);
+
+        // may post again
+        for (ze_reactor_wait_t & w : ready)
+            w.coroutine.resume();
+        r->nresumed.fetch_add(ready.size(), std::memory_order_relaxed);
+
+        if (ready.empty())
+        {
+            if (r->mode == ZE_REACTOR_BLOCK && !pending.empty())
+            {
+                ze_result_t res = zeEventHostSynchronize(pending[0].event, ZE_REACTOR_TIMEOUT_NS);
+                if (res != ZE_RESULT_SUCCESS && res != ZE_RESULT_NOT_READY)
+                    ZE_SAFE_CALL(res);
+            }
+            else
+                sched_yield();
+        }
+        ready.clear();
+    }
+    if (!pending.empty())
+        LOGGER_WARN("Reactor stopped with %zu tasks still waiting", pending.size());
+}
+
+static inline void
+ze_reactor_init(ze_reactor_t * r, event_allocator_t * events, ze_reactor_mode_t mode)
+{
+    r->events = events;
+    r->mode   = mode;
+    r->stop.store(false);
+    r->nresumed.store(0);
+    r->thread = std::thread(ze_reactor_loop, r);
+}
+
+static inline void
+ze_reactor_deinit(ze_reactor_t * r)
+{
+    r->stop.store(true, std::memory_order_release);
+    r->thread.join();
+}
+
+// run a task on the reactor
+static inline void
+ze_task_start(ze_reactor_t * r, ze_task & task)
+{
+    ze_reactor_post(r, NULL, task.handle);
+}
+
+// wait for a started task to return, and destroy it
+static inline void
+ze_task_join(ze_task & task)
+{
+    task.finished->wait(false, std::memory_order_acquire);
+    task.handle.destroy();
+    task.handle = nullptr;
+}
+
+// 'co_await'-ed copy, see 'copy_region'
+typedef struct  ze_copy_awaitable_s
+{
+    ze_reactor_t * reactor;
+    event_t * event;
+
+    bool await_ready() { return zeEventQueryStatus(this->event->event) == ZE_RESULT_SUCCESS; }
+    void await_suspend(std::coroutine_handle<> h) { ze_reactor_post(this->reactor, this->event->event, h); }
+    void await_resume() { event_free(this->reactor->events, this->event); }
+}               ze_copy_awaitable_t;
+
+// append a copy of 'region' to 'list', to be awaited from a task of the reactor 'r'
+static inline ze_copy_awaitable_t
+copy_region(ze_reactor_t * r, ze_command_list_handle_t list, const strided_region_t & region)
+{
+    event_t * e = event_alloc(r->events);
+    strided_copy_ze_region(list, &region, e->event, 0, NULL);
+    return { r, e };
+}
+
+#endif /* __ZE_CORO_H__ */
@@ -0,0 +1,211 @@
+#ifndef __ZE_DEVICE_POOL_H__
+# define __ZE_DEVICE_POOL_H__
+
+/**
+ *  Device memory for tiles, from one of:
+ *      - tile      one 'zeMemAllocDevice' and 'zeContextMakeMemoryResident'
+ *                  per tile, freed with 'zeMemFree'
+ *      - pool      tiles carved out of 'zeMemAllocDevice' slabs
+ *      - vm        tiles carved out of slabs of reserved virtual addresses
+ *                  ('zeVirtualMemReserve') mapped to physical device memory
+ *                  ('zePhysicalMemCreate', 'zeVirtualMemMap')
+ *
+ *      device_pool_t pool;
+ *      device_pool_init(&pool, DEVICE_POOL_VM, context, device, 256 << 20, 64 << 10);
+ *      void * p = device_pool_alloc(&pool, size);
+ *      ...
+ *      device_pool_free(&pool, p, size);
+ *      device_pool_deinit(&pool);
+ *
+ *  Sizes are rounded up to the pool alignment. A slab is allocated when the
+ *  current one is full (large requests get a slab of their own), and blocks
+ *  are bump-allocated from it. Freed blocks go to a free-list per rounded
+ *  size, and are handed back as is to the next allocation of that size: a
+ *  benchmark releasing and allocating the same tiles at each iteration
+ *  makes no driver call once its slabs are allocated. Slabs are only
+ *  released by 'device_pool_deinit'.
+ */
+
+# include <stdint.h>
+
+# include <map>
+# include <vector>
+
+# include <ze_api.h>
+
+# include "logger-ze.h"
+
+typedef enum    device_pool_kind_e
+{
+    DEVICE_POOL_TILE,
+    DEVICE_POOL_POOL,
+    DEVICE_POOL_VM,
+    DEVICE_POOL_MAX
+}               device_pool_kind_t;
+
+static const char * DEVICE_POOL_NAMES[DEVICE_POOL_MAX] __attribute__((unused)) = {
+    "tile",
+    "pool",
+    "vm"
+};
+
+typedef struct  device_pool_slab_s
+{
+    char * ptr;
+    size_t size;
+    size_t used;
+    ze_physical_mem_handle_t physical;  // for 'vm' slabs
+}               device_pool_slab_t;
+
+typedef struct  device_pool_s
+{
+    device_pool_kind_t kind;
+    ze_context_handle_t context;
+    ze_device_handle_t device;
+    size_t slab_size;
+    size_t alignment;
+    std::vector<device_pool_slab_t> slabs;
+    std::map<size_t, std::vector<void *>> free;     // free blocks per rounded size
+
+    // statistics
+    unsigned int nallocs;       // allocations
+    unsigned int nrecycled;     // allocations served by the free-lists
+}               device_pool_t;
+
+static inline size_t
+device_pool_round(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+static inline void
+device_pool_init(
+    device_pool_t * pool,
+    device_pool_kind_t kind,
+    ze_context_handle_t context, ze_device_handle_t device,
+    size_t slab_size, size_t alignment
+) {
+    pool->kind      = kind;
+    pool->context   = context;
+    pool->device    = device;
+    pool->alignment = alignment ? alignment : 64;
+    pool->nallocs   = 0;
+    pool->nrecycled = 0;
+
+    // virtual memory is mapped by pages
+    if (kind == DEVICE_POOL_VM)
+    {
+        size_t page;
+        ZE_SAFE_CALL(zeVirtualMemQueryPageSize(context, device, slab_size, &page));
+        if (pool->alignment < page)
+            pool->alignment = page;
+    }
+    pool->slab_size = device_pool_round(slab_size, pool->alignment);
+}
+
+// allocate a new slab of at least 'size' bytes
+static inline device_pool_slab_t &
+device_pool_slab(device_pool_t * pool, size_t size)
+{
+    device_pool_slab_t slab;
+    slab.size     = size > pool->slab_size ? size : pool->slab_size;
+    slab.used     = 0;
+    slab.physical = NULL;
+
+    if (pool->kind == DEVICE_POOL_VM)
+    {
+        ZE_SAFE_CALL(zeVirtualMemReserve(pool->context, NULL, slab.size, (void **) &slab.ptr));
+        ze_physical_mem_desc_t physicalDesc = {
+            .stype  = ZE_STRUCTURE_TYPE_PHYSICAL_MEM_DESC,
+            .pNext  = NULL,
+            .flags  = 0,
+            .size   = slab.size
+        };
+        ZE_SAFE_CALL(zePhysicalMemCreate(pool->context, pool->device, &physicalDesc, &slab.physical));
+        ZE_SAFE_CALL(zeVirtualMemMap(pool->context, slab.ptr, slab.size, slab.physical, 0, ZE_MEMORY_ACCESS_ATTRIBUTE_READWRITE));
+    }
+    else
+    {
+        const ze_device_mem_alloc_desc_t deviceDesc = {
+            .stype   = ZE_STRUCTURE_TYPE_DEVICE_MEM_ALLOC_DESC,
+            .pNext   = NULL,
+            .flags   = 0,
+            .ordinal = 0,
+        };
+        ZE_SAFE_CALL(zeMemAllocDevice(pool->context, &deviceDesc, slab.size, pool->alignment, pool->device, (void **) &slab.ptr));
+        ZE_SAFE_CALL(zeContextMakeMemoryResident(pool->context, pool->device, slab.ptr, slab.size));
+    }
+    LOGGER_DEBUG("New `%s` slab of %zu bytes at %p", DEVICE_POOL_NAMES[pool->kind], slab.size, slab.ptr);
+
+    pool->slabs.push_back(slab);
+    return pool->slabs.back();
+}
+
+static inline void *
+device_pool_alloc(device_pool_t * pool, size_t size)
+{
+    ++pool->nallocs;
+
+    if (pool->kind == DEVICE_POOL_TILE)
+    {
+        const ze_device_mem_alloc_desc_t deviceDesc = {
+            .stype   = ZE_STRUCTURE_TYPE_DEVICE_MEM_ALLOC_DESC,
+            .pNext   = NULL,
+            .flags   = 0,
+            .ordinal = 0,
+        };
+        void * ptr;
+        ZE_SAFE_CALL(zeMemAllocDevice(pool->context, &deviceDesc, size, pool->alignment, pool->device, &ptr));
+        ZE_SAFE_CALL(zeContextMakeMemoryResident(pool->context, pool->device, ptr, size));
+        return ptr;
+    }
+
+    size = device_pool_round(size, pool->alignment);
+
+    // a block freed with the same size
+    std::vector<void *> & blocks = pool->free[size];
+    if (!blocks.empty())
+    {
+        void * ptr = blocks.back();
+        blocks.pop_back();
+        ++pool->nrecycled;
+        return ptr;
+    }
+
+    // bump-allocate from the last slab
+    device_pool_slab_t * slab = pool->slabs.empty() ? NULL : &pool->slabs.back();
+    if (slab == NULL || slab->size - slab->used < size)
+        slab = &device_pool_slab(pool, size);
+    void * ptr = slab->ptr + slab->used;
+    slab->used += size;
+    return ptr;
+}
+
+static inline void
+device_pool_free(device_pool_t * pool, void * ptr, size_t size)
+{
+    if (pool->kind == DEVICE_POOL_TILE)
+        ZE_SAFE_CALL(zeMemFree(pool->context, ptr));
+    else
+        pool->free[device_pool_round(size, pool->alignment)].push_back(ptr);
+}
+
+static inline void
+device_pool_deinit(device_pool_t * pool)
+{
+    for (device_pool_slab_t & slab : pool->slabs)
+    {
+        if (pool->kind == DEVICE_POOL_VM)
+        {
+            ZE_SAFE_CALL(zeVirtualMemUnmap(pool->context, slab.ptr, slab.size));
+            ZE_SAFE_CALL(zePhysicalMemDestroy(pool->context, slab.physical));
+            ZE_SAFE_CALL(zeVirtualMemFree(pool->context, slab.ptr, slab.size));
+        }
+        else
+            ZE_SAFE_CALL(zeMemFree(pool->context, slab.ptr));
+    }
+    pool->slabs.clear();
+    pool->free.clear();
+}
+
+#endif /* __ZE_DEVICE_POOL_H__ */
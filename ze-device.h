@@ -0,0 +1,195 @@
+#ifndef __ZE_DEVICE_H__
+# define __ZE_DEVICE_H__
+
+/**
+ *  Level Zero setup shared by the copy benchmarks: the first device of the
+ *  first driver, a context, and its copy engines.
+ *
+ *      ze_device_t ze;
+ *      ze_device_init(&ze);
+ *      ze_engine_t engines[N];
+ *      unsigned int n = ze_device_engines(&ze, ZE_ENGINES_COPY, engines, N);
+ *      ... engines[i].list ...
+ *      ze_device_engines_release(engines, n);
+ *      ze_device_deinit(&ze);
+ *
+ *  An engine is a queue (index) of a command queue group (ordinal), with an
+ *  asynchronous immediate command list on it.
+ */
+
+# include <stdint.h>
+
+# include <vector>
+
+# include <ze_api.h>
+
+# include "logger-ze.h"
+
+typedef struct  ze_device_s
+{
+    ze_driver_handle_t driver;
+    ze_device_handle_t device;
+    ze_context_handle_t context;
+}               ze_device_t;
+
+typedef struct  ze_engine_s
+{
+    uint32_t ordinal;
+    uint32_t index;
+    ze_command_list_handle_t list;
+}               ze_engine_t;
+
+// engines returned by 'ze_device_engines'
+typedef enum    ze_engines_e
+{
+    ZE_ENGINES_COPY,        // copy-only queue groups
+    ZE_ENGINES_COMPUTE,     // compute queue groups
+    ZE_ENGINES_ALL,         // both, copy-only first
+    ZE_ENGINES_MAX
+}               ze_engines_t;
+
+static const char * ZE_ENGINES_NAMES[ZE_ENGINES_MAX] __attribute__((unused)) = {
+    "copy",
+    "compute",
+    "all"
+};
+
+static inline void
+ze_device_init(ze_device_t * ze)
+{
+    ze_init_flag_t initFlags = ZE_INIT_FLAG_GPU_ONLY;
+    ZE_SAFE_CALL(zeInit(initFlags));
+
+    // driver
+    uint32_t driverCount = 1;
+    ZE_SAFE_CALL(zeDriverGet(&driverCount, &ze->driver));
+
+    // device
+    uint32_t deviceCount = 1;
+    ZE_SAFE_CALL(zeDeviceGet(ze->driver, &deviceCount, &ze->device));
+
+    // context
+    ze_context_desc_t contextDesc = {
+        .stype = ZE_STRUCTURE_TYPE_CONTEXT_DESC,
+        .pNext = NULL,
+        .flags = ZE_CONTEXT_FLAG_TBD
+    };
+    ZE_SAFE_CALL(zeContextCreate(ze->driver, &contextDesc, &ze->context));
+}
+
+static inline void
+ze_device_deinit(ze_device_t * ze)
+{
+    ZE_SAFE_CALL(zeContextDestroy(ze->context));
+}
+
+// an asynchronous immediate command list on the queue 'index' of the group 'ordinal',
+// in-order with 'ZE_COMMAND_QUEUE_FLAG_IN_ORDER' in 'flags'
+static inline ze_command_list_handle_t
+ze_device_immediate_list(
+    ze_device_t * ze, uint32_t ordinal, uint32_t index,
+    ze_command_queue_flags_t flags = ZE_COMMAND_QUEUE_FLAG_EXPLICIT_ONLY
+) {
+    ze_command_list_handle_t list;
+    const ze_command_queue_desc_t queueDesc = {
+        .stype      = ZE_STRUCTURE_TYPE_COMMAND_QUEUE_DESC,
+        .pNext      = NULL,
+        .ordinal    = ordinal,
+        .index      = index,
+        .flags      = flags,
+        .mode       = ZE_COMMAND_QUEUE_MODE_ASYNCHRONOUS,
+        .priority   = ZE_COMMAND_QUEUE_PRIORITY_PRIORITY_LOW
+    };
+    ZE_SAFE_CALL(zeCommandListCreateImmediate(ze->context, ze->device, &queueDesc, &list));
+    return list;
+}
+
+// a command queue on the queue 'index' of the group 'ordinal', to execute regular command lists
+static inline ze_command_queue_handle_t
+ze_device_queue(ze_device_t * ze, uint32_t ordinal, uint32_t index)
+{
+    ze_command_queue_handle_t queue;
+    const ze_command_queue_desc_t queueDesc = {
+        .stype      = ZE_STRUCTURE_TYPE_COMMAND_QUEUE_DESC,
+        .pNext      = NULL,
+        .ordinal    = ordinal,
+        .index      = index,
+        .flags      = ZE_COMMAND_QUEUE_FLAG_EXPLICIT_ONLY,
+        .mode       = ZE_COMMAND_QUEUE_MODE_ASYNCHRONOUS,
+        .priority   = ZE_COMMAND_QUEUE_PRIORITY_PRIORITY_LOW
+    };
+    ZE_SAFE_CALL(zeCommandQueueCreate(ze->context, ze->device, &queueDesc, &queue));
+    return queue;
+}
+
+// a regular command list, for queues of the group 'ordinal'
+static inline ze_command_list_handle_t
+ze_device_list(ze_device_t * ze, uint32_t ordinal)
+{
+    ze_command_list_handle_t list;
+    const ze_command_list_desc_t listDesc = {
+        .stype                      = ZE_STRUCTURE_TYPE_COMMAND_LIST_DESC,
+        .pNext                      = NULL,
+        .commandQueueGroupOrdinal   = ordinal,
+        .flags                      = 0
+    };
+    ZE_SAFE_CALL(zeCommandListCreate(ze->context, ze->device, &listDesc, &list));
+    return list;
+}
+
+/**
+ *  List the command queue groups, and create an immediate command list on
+ *  up to 'max' engines of the 'which' groups. Returns the number of engines.
+ */
+static inline unsigned int
+ze_device_engines(ze_device_t * ze, ze_engines_t which, ze_engine_t * engines, unsigned int max)
+{
+    uint32_t ngroups = 0;
+    ZE_SAFE_CALL(zeDeviceGetCommandQueueGroupProperties(ze->device, &ngroups, NULL));
+    std::vector<ze_command_queue_group_properties_t> groupsProperties(ngroups);
+    for (ze_command_queue_group_properties_t & properties : groupsProperties)
+    {
+        properties.stype = ZE_STRUCTURE_TYPE_COMMAND_QUEUE_GROUP_PROPERTIES;
+        properties.pNext = NULL;
+    }
+    ZE_SAFE_CALL(zeDeviceGetCommandQueueGroupProperties(ze->device, &ngroups, groupsProperties.data()));
+
+    // engines of the selected groups, copy-only groups first
+    unsigned int n = 0;
+    for (int compute = 0 ; compute <= 1 ; ++compute)
+    {
+        for (uint32_t ordinal = 0 ; ordinal < ngroups ; ++ordinal)
+        {
+            const ze_command_queue_group_properties_t & properties = groupsProperties[ordinal];
+            const bool is_compute = properties.flags & ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COMPUTE;
+            const bool is_copy    = properties.flags & ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COPY;
+            if (compute == 0)
+                LOGGER_INFO("Queue group `%u`: %u engines%s%s", ordinal, properties.numQueues,
+                        is_compute ? " compute" : "", is_copy ? " copy" : "");
+
+            if (!is_copy || is_compute != (bool) compute)
+                continue ;
+            if ((which == ZE_ENGINES_COPY && compute) || (which == ZE_ENGINES_COMPUTE && !compute))
+                continue ;
+
+            for (uint32_t index = 0 ; index < properties.numQueues && n < max ; ++index)
+            {
+                ze_engine_t & engine = engines[n++];
+                engine.ordinal = ordinal;
+                engine.index   = index;
+                engine.list    = ze_device_immediate_list(ze, ordinal, index);
+            }
+        }
+    }
+
+    return n;
+}
+
+static inline void
+ze_device_engines_release(ze_engine_t * engines, unsigned int n)
+{
+    for (unsigned int e = 0 ; e < n ; ++e)
+        ZE_SAFE_CALL(zeCommandListDestroy(engines[e].list));
+}
+
+#endif /* __ZE_DEVICE_H__ */
@@ -0,0 +1,215 @@
+#ifndef __ZE_EVENT_POOL_H__
+# define __ZE_EVENT_POOL_H__
+
+/**
+ *  Event allocator with no bound on the number of events in flight.
+ *
+ *      event_allocator_t a;
+ *      event_allocator_init(&a, context, device, 64, false);
+ *      event_t * e = event_alloc(&a);
+ *      ... zeCommandListAppendMemoryCopy(..., e->event, ...) ...
+ *      event_free(&a, e);
+ *      event_allocator_deinit(&a);
+ *
+ *  Events are taken from a lock-free free-list (a Treiber stack whose head
+ *  carries an ABA counter in its upper 16 bits). When it is empty, a new
+ *  event pool twice as large as the previous one is created under a lock,
+ *  and its events are pushed to the free-list. Pools are only destroyed by
+ *  'event_allocator_deinit', so free-list nodes are always valid.
+ *
+ *  'event_free' host-resets the event before recycling it. With
+ *  'counter_based', pools are created with the counter-based extension
+ *  ('ZE_experimental_event_pool_counter_based', check it with
+ *  'event_counter_based_supported'): such events are reset implicitly when
+ *  signaled again, are never host-reset, and must be signaled from in-order
+ *  command lists.
+ */
+
+# include <stdint.h>
+# include <string.h>
+
+# include <vector>
+
+# include <ze_api.h>
+
+# include "logger-ze.h"
+# include "spinlock.h"
+
+// largest event pool created
+# define EVENT_POOL_MAX_SIZE (64 * 1024)
+
+typedef struct  event_s
+{
+    ze_event_handle_t event;
+    struct event_s * next;
+}               event_t;
+
+typedef struct  event_allocator_s
+{
+    ze_context_handle_t context;
+    ze_device_handle_t device;
+    bool counter_based;
+    uint32_t pool_size;                 // size of the next pool
+    std::vector<ze_event_pool_handle_t> pools;
+    std::vector<event_t *> nodes;       // the events of each pool
+    std::vector<uint32_t> sizes;        // the size of each pool
+    uint64_t head;                      // free-list, ABA counter << 48 | event_t *
+    spinlock_tas_t grow;                // serializes pool creations
+}               event_allocator_t;
+
+# define EVENT_HEAD_PTR(H)      ((event_t *) ((H) & ((1ULL << 48) - 1)))
+# define EVENT_HEAD(P, H)       ((uint64_t) (uintptr_t) (P) | ((((H) >> 48) + 1) << 48))
+
+// if the driver offers counter-based events
+static inline bool
+event_counter_based_supported(ze_driver_handle_t driver)
+{
+# ifdef ZE_EVENT_POOL_COUNTER_BASED_EXP_NAME
+    uint32_t n = 0;
+    ZE_SAFE_CALL(zeDriverGetExtensionProperties(driver, &n, NULL));
+    std::vector<ze_driver_extension_properties_t> extensions(n);
+    ZE_SAFE_CALL(zeDriverGetExtensionProperties(driver, &n, extensions.data()));
+    for (const ze_driver_extension_properties_t & extension : extensions)
+        if (strcmp(extension.name, ZE_EVENT_POOL_COUNTER_BASED_EXP_NAME) == 0)
+            return true;
+# else
+    (void) driver;
+# endif /* ZE_EVENT_POOL_COUNTER_BASED_EXP_NAME */
+    return false;
+}
+
+static inline void
+event_allocator_init(
+    event_allocator_t * a,
+    ze_context_handle_t context, ze_device_handle_t device,
+    uint32_t initial, bool counter_based
+) {
+    a->context       = context;
+    a->device        = device;
+    a->counter_based = counter_based;
+    a->pool_size     = initial ? initial : 1;
+    a->head          = 0;
+}
+
+// push the chain 'first' ... 'last' to the free-list
+static inline void
+event_push(event_allocator_t * a, event_t * first, event_t * last)
+{
+    uint64_t head = __atomic_load_n(&a->head, __ATOMIC_RELAXED);
+    do {
+        last->next = EVENT_HEAD_PTR(head);
+    } while (!__atomic_compare_exchange_n(&a->head, &head, EVENT_HEAD(first, head), true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// pop an event from the free-list, or NULL if empty
+static inline event_t *
+event_pop(event_allocator_t * a)
+{
+    uint64_t head = __atomic_load_n(&a->head, __ATOMIC_ACQUIRE);
+    event_t * e;
+    while ((e = EVENT_HEAD_PTR(head)) != NULL)
+    {
+        // 'e' may have been popped meanwhile: its 'next' is then stale, but
+        // readable, and the ABA counter fails the exchange
+        if (__atomic_compare_exchange_n(&a->head, &head, EVENT_HEAD(e->next, head), true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+            break ;
+    }
+    return e;
+}
+
+// create a new pool and push its events to the free-list
+static inline void
+event_allocator_grow(event_allocator_t * a)
+{
+    const uint32_t n = a->pool_size;
+    if (a->pool_size < EVENT_POOL_MAX_SIZE)
+        a->pool_size *= 2;
+
+    ze_event_pool_handle_t pool;
+    ze_event_pool_desc_t poolDesc = {
+        .stype  = ZE_STRUCTURE_TYPE_EVENT_POOL_DESC,
+        .pNext  = NULL,
+        .flags  = ZE_EVENT_POOL_FLAG_HOST_VISIBLE,
+        .count  = n
+    };
+# ifdef ZE_EVENT_POOL_COUNTER_BASED_EXP_NAME
+    const ze_event_pool_counter_based_exp_desc_t counterDesc = {
+        .stype  = ZE_STRUCTURE_TYPE_COUNTER_BASED_EVENT_POOL_EXP_DESC,
+        .pNext  = NULL,
+        .flags  = ZE_EVENT_POOL_COUNTER_BASED_EXP_FLAG_IMMEDIATE
+    };
+    if (a->counter_based)
+        poolDesc.pNext = &counterDesc;
+# endif /* ZE_EVENT_POOL_COUNTER_BASED_EXP_NAME */
+    ZE_SAFE_CALL(zeEventPoolCreate(a->context, &poolDesc, 1, &a->device, &pool));
+
+    event_t * nodes = new event_t[n];
+    for (uint32_t i = 0 ; i < n ; ++i)
+    {
+        const ze_event_desc_t eventDesc = {
+            .stype  = ZE_STRUCTURE_TYPE_EVENT_DESC,
+            .pNext  = NULL,
+            .index  = i,
+            .signal = ZE_EVENT_SCOPE_FLAG_HOST,
+            .wait   = ZE_EVENT_SCOPE_FLAG_HOST,
+        };
+        ZE_SAFE_CALL(zeEventCreate(pool, &eventDesc, &nodes[i].event));
+        nodes[i].next = i + 1 < n ? nodes + i + 1 : NULL;
+    }
+    LOGGER_DEBUG("New event pool of %u%s events", n, a->counter_based ? " counter-based" : "");
+
+    a->pools.push_back(pool);
+    a->nodes.push_back(nodes);
+    a->sizes.push_back(n);
+    event_push(a, nodes, nodes + n - 1);
+}
+
+static inline event_t *
+event_alloc(event_allocator_t * a)
+{
+    event_t * e;
+    while ((e = event_pop(a)) == NULL)
+    {
+        // another thread may have grown the allocator while we waited
+        spinlock_guard<spinlock_tas_t> guard(a->grow);
+        if (EVENT_HEAD_PTR(__atomic_load_n(&a->head, __ATOMIC_ACQUIRE)) == NULL)
+            event_allocator_grow(a);
+    }
+    return e;
+}
+
+static inline void
+event_free(event_allocator_t * a, event_t * e)
+{
+    if (!a->counter_based)
+        ZE_SAFE_CALL(zeEventHostReset(e->event));
+    event_push(a, e, e);
+}
+
+// number of events created
+static inline unsigned int
+event_allocator_size(const event_allocator_t * a)
+{
+    unsigned int n = 0;
+    for (uint32_t size : a->sizes)
+        n += size;
+    return n;
+}
+
+static inline void
+event_allocator_deinit(event_allocator_t * a)
+{
+    for (size_t p = 0 ; p < a->pools.size() ; ++p)
+    {
+        for (uint32_t i = 0 ; i < a->sizes[p] ; ++i)
+            ZE_SAFE_CALL(zeEventDestroy(a->nodes[p][i].event));
+        ZE_SAFE_CALL(zeEventPoolDestroy(a->pools[p]));
+        delete [] a->nodes[p];
+    }
+    a->pools.clear();
+    a->nodes.clear();
+    a->sizes.clear();
+    a->head = 0;
+}
+
+#endif /* __ZE_EVENT_POOL_H__ */
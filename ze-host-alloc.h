@@ -0,0 +1,268 @@
+#ifndef __ZE_HOST_ALLOC_H__
+# define __ZE_HOST_ALLOC_H__
+
+/**
+ *  Host buffers for device transfers, from one of:
+ *      - malloc    pageable memory, the driver stages or pins it on each copy
+ *      - usm       'zeMemAllocHost', pinned by the driver
+ *      - import    page-aligned pageable memory, registered to the driver
+ *                  with the 'zexDriverImportExternalPointer' extension
+ *      - thp       2MB-aligned anonymous memory, 'madvise(MADV_HUGEPAGE)'
+ *      - huge2m    hugetlbfs 2MB pages ('/proc/sys/vm/nr_hugepages')
+ *      - huge1g    hugetlbfs 1GB pages
+ *      - shared    'zeMemAllocShared' with no associated device, migrated
+ *                  on demand between the host and the devices accessing it
+ *
+ *      host_alloc_t a;
+ *      if (host_alloc(HOST_ALLOC_USM, driver, context, size, &a))
+ *          ... a.ptr ...
+ *      host_free(&a);
+ *
+ *  'host_alloc' returns 'false' if the memory kind is not available (no
+ *  huge pages reserved, no import extension), and 'a.alloc_ns' is the time
+ *  spent allocating and registering the buffer, so that the cost of a
+ *  pinned buffer can be compared with what it saves on transfers.
+ */
+
+# ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+# endif /* _GNU_SOURCE */
+# include <stdint.h>
+# include <stdlib.h>
+# include <sys/mman.h>
+# include <time.h>
+# include <unistd.h>
+
+# include <ze_api.h>
+
+# include "logger-ze.h"
+
+# ifndef MAP_HUGE_SHIFT
+#  define MAP_HUGE_SHIFT 26
+# endif
+# ifndef MAP_HUGE_2MB
+#  define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+# endif
+# ifndef MAP_HUGE_1GB
+#  define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+# endif
+
+typedef enum    host_alloc_kind_e
+{
+    HOST_ALLOC_MALLOC,
+    HOST_ALLOC_USM,
+    HOST_ALLOC_IMPORT,
+    HOST_ALLOC_THP,
+    HOST_ALLOC_HUGE_2M,
+    HOST_ALLOC_HUGE_1G,
+    HOST_ALLOC_SHARED,
+    HOST_ALLOC_MAX
+}               host_alloc_kind_t;
+
+static const char * HOST_ALLOC_NAMES[HOST_ALLOC_MAX] __attribute__((unused)) = {
+    "malloc",
+    "usm",
+    "import",
+    "thp",
+    "huge2m",
+    "huge1g",
+    "shared"
+};
+
+typedef struct  host_alloc_s
+{
+    host_alloc_kind_t kind;
+    void * ptr;
+    size_t size;        // size requested
+    size_t mapped;      // size mapped, for mmap-ed kinds
+    uint64_t alloc_ns;  // allocation and registration time
+    ze_driver_handle_t driver;
+    ze_context_handle_t context;
+}               host_alloc_t;
+
+// the external pointer import extension of the Intel driver
+typedef ze_result_t (*host_alloc_import_t)(ze_driver_handle_t driver, void * ptr, size_t size);
+typedef ze_result_t (*host_alloc_release_t)(ze_driver_handle_t driver, void * ptr);
+
+static inline uint64_t
+host_alloc_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static inline size_t
+host_alloc_round(size_t size, size_t page)
+{
+    return (size + page - 1) / page * page;
+}
+
+static inline bool
+host_alloc_import_functions(ze_driver_handle_t driver, host_alloc_import_t * import, host_alloc_release_t * release)
+{
+    void * f = NULL;
+    void * g = NULL;
+    if (zeDriverGetExtensionFunctionAddress(driver, "zexDriverImportExternalPointer", &f) != ZE_RESULT_SUCCESS || f == NULL)
+        return false;
+    if (zeDriverGetExtensionFunctionAddress(driver, "zexDriverReleaseImportedPointer", &g) != ZE_RESULT_SUCCESS || g == NULL)
+        return false;
+    *import  = (host_alloc_import_t)  f;
+    *release = (host_alloc_release_t) g;
+    return true;
+}
+
+static inline bool
+host_alloc(
+    host_alloc_kind_t kind,
+    ze_driver_handle_t driver, ze_context_handle_t context,
+    size_t size,
+    host_alloc_t * a
+) {
+    a->kind     = kind;
+    a->ptr      = NULL;
+    a->size     = size;
+    a->mapped   = 0;
+    a->driver   = driver;
+    a->context  = context;
+
+    const size_t page = sysconf(_SC_PAGESIZE);
+    const uint64_t t0 = host_alloc_now();
+    switch (kind)
+    {
+        case (HOST_ALLOC_MALLOC):
+        {
+            a->ptr = malloc(size);
+            break ;
+        }
+
+        case (HOST_ALLOC_USM):
+        {
+            const ze_host_mem_alloc_desc_t hostDesc = {
+                .stype = ZE_STRUCTURE_TYPE_HOST_MEM_ALLOC_DESC,
+                .pNext = NULL,
+                .flags = 0
+            };
+            ZE_SAFE_CALL(zeMemAllocHost(context, &hostDesc, size, page, &a->ptr));
+            break ;
+        }
+
+        case (HOST_ALLOC_IMPORT):
+        {
+            host_alloc_import_t import;
+            host_alloc_release_t release;
+            if (!host_alloc_import_functions(driver, &import, &release))
+            {
+                LOGGER_WARN("The driver has no external pointer import extension");
+                return false;
+            }
+            a->mapped = host_alloc_round(size, page);
+            a->ptr = aligned_alloc(page, a->mapped);
+            if (a->ptr)
+                ZE_SAFE_CALL(import(driver, a->ptr, a->mapped));
+            break ;
+        }
+
+        case (HOST_ALLOC_THP):
+        {
+            // over-allocate to align on a huge page
+            const size_t huge = 2 * 1024 * 1024;
+            a->mapped = host_alloc_round(size, huge) + huge;
+            void * p = mmap(NULL, a->mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                break ;
+            const uintptr_t aligned = ((uintptr_t) p + huge - 1) & ~(uintptr_t) (huge - 1);
+            const size_t head = aligned - (uintptr_t) p;
+            if (head)
+                munmap(p, head);
+            const size_t tail = a->mapped - head - host_alloc_round(size, huge);
+            if (tail)
+                munmap((char *) aligned + host_alloc_round(size, huge), tail);
+            a->mapped = host_alloc_round(size, huge);
+            a->ptr = (void *) aligned;
+            if (madvise(a->ptr, a->mapped, MADV_HUGEPAGE))
+                LOGGER_WARN("`madvise(MADV_HUGEPAGE)` failed, transparent huge pages may be disabled");
+            break ;
+        }
+
+        case (HOST_ALLOC_HUGE_2M):
+        case (HOST_ALLOC_HUGE_1G):
+        {
+            const size_t huge  = kind == HOST_ALLOC_HUGE_2M ? 2 * 1024 * 1024 : 1024 * 1024 * 1024;
+            const int    flags = kind == HOST_ALLOC_HUGE_2M ? MAP_HUGE_2MB : MAP_HUGE_1GB;
+            a->mapped = host_alloc_round(size, huge);
+            void * p = mmap(NULL, a->mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | flags, -1, 0);
+            if (p == MAP_FAILED)
+            {
+                LOGGER_WARN("Cannot map %zu bytes of `%s` pages, are enough huge pages reserved ?", a->mapped, HOST_ALLOC_NAMES[kind]);
+                return false;
+            }
+            a->ptr = p;
+            break ;
+        }
+
+        case (HOST_ALLOC_SHARED):
+        {
+            const ze_device_mem_alloc_desc_t deviceDesc = {
+                .stype   = ZE_STRUCTURE_TYPE_DEVICE_MEM_ALLOC_DESC,
+                .pNext   = NULL,
+                .flags   = 0,
+                .ordinal = 0,
+            };
+            const ze_host_mem_alloc_desc_t hostDesc = {
+                .stype = ZE_STRUCTURE_TYPE_HOST_MEM_ALLOC_DESC,
+                .pNext = NULL,
+                .flags = 0
+            };
+            ZE_SAFE_CALL(zeMemAllocShared(context, &deviceDesc, &hostDesc, size, page, NULL, &a->ptr));
+            break ;
+        }
+
+        default:
+            LOGGER_FATAL("Unknown host allocator");
+    }
+    a->alloc_ns = host_alloc_now() - t0;
+
+    if (a->ptr == NULL)
+        LOGGER_FATAL("Cannot allocate %zu bytes of `%s` host memory", size, HOST_ALLOC_NAMES[kind]);
+
+    return true;
+}
+
+static inline void
+host_free(host_alloc_t * a)
+{
+    switch (a->kind)
+    {
+        case (HOST_ALLOC_MALLOC):
+            free(a->ptr);
+            break ;
+
+        case (HOST_ALLOC_USM):
+        case (HOST_ALLOC_SHARED):
+            ZE_SAFE_CALL(zeMemFree(a->context, a->ptr));
+            break ;
+
+        case (HOST_ALLOC_IMPORT):
+        {
+            host_alloc_import_t import;
+            host_alloc_release_t release;
+            if (host_alloc_import_functions(a->driver, &import, &release))
+                ZE_SAFE_CALL(release(a->driver, a->ptr));
+            free(a->ptr);
+            break ;
+        }
+
+        case (HOST_ALLOC_THP):
+        case (HOST_ALLOC_HUGE_2M):
+        case (HOST_ALLOC_HUGE_1G):
+            munmap(a->ptr, a->mapped);
+            break ;
+
+        default:
+            break ;
+    }
+    a->ptr = NULL;
+}
+
+#endif /* __ZE_HOST_ALLOC_H__ */
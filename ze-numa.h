@@ -0,0 +1,221 @@
+#ifndef __ZE_NUMA_H__
+# define __ZE_NUMA_H__
+
+/**
+ *  NUMA placement of host buffers and threads, relative to a device.
+ *
+ *      int node = ze_device_numa_node(device);     // -1 if unknown
+ *      numa_bind_thread(node);                     // run on the cpus of 'node'
+ *      numa_bind_memory(ptr, size, node);          // pages of 'ptr' on 'node'
+ *      numa_where("submit");                       // log the current cpu/node
+ *
+ *  The node of a device is the one of its PCI function, read from
+ *  '/sys/bus/pci/devices/DOMAIN:BUS:DEVICE.FUNCTION/numa_node', and may be
+ *  overridden with the environment variable 'ZE_NUMA_NODE'.
+ *
+ *  Memory is bound with the 'mbind' system call ('MPOL_BIND', moving pages
+ *  already touched), so that no libnuma is needed: bind buffers before
+ *  writing them, so that they are first-touched on the right node. Pages
+ *  the driver pins or migrates itself (USM host or shared allocations,
+ *  imported pointers) are not moved: allocate those from a thread bound
+ *  to the node instead.
+ */
+
+# ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+# endif /* _GNU_SOURCE */
+# include <sched.h>
+# include <stdint.h>
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+
+# include <ze_api.h>
+
+# include "logger-ze.h"
+
+# ifndef MPOL_BIND
+#  define MPOL_BIND 2
+# endif
+# ifndef MPOL_MF_MOVE
+#  define MPOL_MF_MOVE (1 << 1)
+# endif
+
+// maximum number of nodes
+# define NUMA_NODES_MAX 1024
+
+// placement of host buffers relative to a device
+typedef enum    numa_placement_e
+{
+    NUMA_PLACEMENT_NONE,    // left to the first touch, wherever the thread runs
+    NUMA_PLACEMENT_LOCAL,   // on the node of the device
+    NUMA_PLACEMENT_REMOTE,  // on another node
+    NUMA_PLACEMENT_MAX
+}               numa_placement_t;
+
+static const char * NUMA_PLACEMENT_NAMES[NUMA_PLACEMENT_MAX] __attribute__((unused)) = {
+    "none",
+    "local",
+    "remote"
+};
+
+// the node of the PCI function of 'device', or -1 if unknown
+static inline int
+ze_device_numa_node(ze_device_handle_t device)
+{
+    const char * env = getenv("ZE_NUMA_NODE");
+    if (env)
+        return atoi(env);
+
+    ze_pci_ext_properties_t properties;
+    memset(&properties, 0, sizeof(properties));
+    properties.stype = ZE_STRUCTURE_TYPE_PCI_EXT_PROPERTIES;
+    properties.pNext = NULL;
+    if (zeDevicePciGetPropertiesExt(device, &properties) != ZE_RESULT_SUCCESS)
+    {
+        LOGGER_WARN("Cannot retrieve the PCI address of the device");
+        return -1;
+    }
+
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/bus/pci/devices/%04x:%02x:%02x.%x/numa_node",
+            properties.address.domain, properties.address.bus,
+            properties.address.device, properties.address.function);
+    FILE * f = fopen(path, "r");
+    if (f == NULL)
+    {
+        LOGGER_WARN("Cannot open `%s`", path);
+        return -1;
+    }
+    int node = -1;
+    if (fscanf(f, "%d", &node) != 1)
+        node = -1;
+    fclose(f);
+
+    LOGGER_DEBUG("Device at %04x:%02x:%02x.%x is on node %d", properties.address.domain,
+            properties.address.bus, properties.address.device, properties.address.function, node);
+    return node;
+}
+
+/**
+ *  The integers of a sysfs list (e.g. '0-3,8-11'), such as a node 'cpulist'
+ *  or the online nodes, as the bits of 'set' (up to 'CPU_SETSIZE', which is
+ *  also 'NUMA_NODES_MAX'). Returns 'false' if the file cannot be read.
+ */
+static inline bool
+numa_read_list(const char * path, cpu_set_t * set)
+{
+    FILE * f = fopen(path, "r");
+    if (f == NULL)
+        return false;
+
+    CPU_ZERO(set);
+    unsigned int first, last;
+    int n;
+    while ((n = fscanf(f, "%u-%u", &first, &last)) >= 1)
+    {
+        if (n == 1)
+            last = first;
+        for (unsigned int k = first ; k <= last && k < CPU_SETSIZE ; ++k)
+            CPU_SET(k, set);
+        if (fgetc(f) != ',')
+            break ;
+    }
+    fclose(f);
+    return true;
+}
+
+// the online nodes, which may not be numbered contiguously (e.g. '0,2')
+static inline bool
+numa_online_nodes(cpu_set_t * nodes)
+{
+    if (numa_read_list("/sys/devices/system/node/online", nodes) && CPU_COUNT(nodes) > 0)
+        return true;
+    CPU_ZERO(nodes);
+    CPU_SET(0, nodes);
+    return false;
+}
+
+// number of online nodes
+static inline int
+numa_nodes(void)
+{
+    cpu_set_t nodes;
+    numa_online_nodes(&nodes);
+    return CPU_COUNT(&nodes);
+}
+
+// an online node other than 'node', or -1 if none
+static inline int
+numa_remote_node(int node)
+{
+    cpu_set_t nodes;
+    numa_online_nodes(&nodes);
+    for (int other = 0 ; other < NUMA_NODES_MAX ; ++other)
+        if (other != node && CPU_ISSET(other, &nodes))
+            return other;
+    return -1;
+}
+
+// the cpus of 'node', parsed from its 'cpulist'
+static inline bool
+numa_node_cpus(int node, cpu_set_t * cpus)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    return numa_read_list(path, cpus) && CPU_COUNT(cpus) > 0;
+}
+
+// bind the calling thread to the cpus of 'node'
+static inline bool
+numa_bind_thread(int node)
+{
+    cpu_set_t cpus;
+    if (!numa_node_cpus(node, &cpus))
+    {
+        LOGGER_WARN("No cpu on node %d", node);
+        return false;
+    }
+    if (sched_setaffinity(0, sizeof(cpus), &cpus))
+    {
+        LOGGER_WARN("Cannot bind the thread to node %d", node);
+        return false;
+    }
+    return true;
+}
+
+// bind the pages of [ptr, ptr + size) to 'node'
+static inline bool
+numa_bind_memory(void * ptr, size_t size, int node)
+{
+    if (node < 0 || node >= NUMA_NODES_MAX)
+        return false;
+
+    const uintptr_t page  = sysconf(_SC_PAGESIZE);
+    const uintptr_t start = (uintptr_t) ptr & ~(page - 1);
+    const uintptr_t end   = ((uintptr_t) ptr + size + page - 1) & ~(page - 1);
+
+    unsigned long mask[NUMA_NODES_MAX / (8 * sizeof(unsigned long))];
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+
+    if (syscall(SYS_mbind, start, end - start, MPOL_BIND, mask, NUMA_NODES_MAX, MPOL_MF_MOVE))
+    {
+        LOGGER_WARN("Cannot bind %zu bytes at %p to node %d", size, ptr, node);
+        return false;
+    }
+    return true;
+}
+
+// log the cpu and node the calling thread is running on
+static inline void
+numa_where(const char * who)
+{
+    unsigned int cpu, node;
+    if (getcpu(&cpu, &node) == 0)
+        LOGGER_DEBUG("`%s` running on cpu %3u of node %3u", who, cpu, node);
+}
+
+#endif /* __ZE_NUMA_H__ */